@@ -10,8 +10,8 @@ layout(location = 0) out vec4 outColor;
 layout(location = 1) out vec4 outNormal;
 
 layout(binding=0) uniform sampler2D uSamplerDiffuse;
-layout(binding=1) uniform sampler2D uSamplerNormal;
-layout(binding=2) uniform sampler2D uSamplerHeight;
+layout(binding=1) uniform sampler2D uSamplerNormalMap;
+layout(binding=2) uniform sampler2D uSamplerHeightMap;
 layout(binding=3) uniform sampler2D uSamplerSpecular;
 
 @utils.inc // encodeNormal
@@ -34,14 +34,10 @@ const float normalSmooth = 1.5; // steeper < 1.0 < smoother
 
 void main()
 {
-	bool normalMappingEnabled   = (PerFrame.flags & 0x1) == 0x1;
-	bool parallaxMappingEnabled = (PerFrame.flags & 0x2) == 0x2;
-	bool materialHasNormalMap = (Material.flags & 0x1) == 0x1;
-	bool materialHasHeightMap = (Material.flags & 0x2) == 0x2;
-
+	// Features are compiled in per variant (see DeferredShaderFeature in Material.h)
 	vec2 texCoord = vsTexcoord;
 
-	if(materialHasHeightMap && parallaxMappingEnabled)
+#if defined(HAS_HEIGHT_MAP) && defined(PARALLAX_MAPPING)
 	{
 		// Calculate new texcoord using parallax mapping
 
@@ -54,19 +50,20 @@ void main()
 
 		float fBumpScale  = heightScale;
 		float bias = (fBumpScale / 2.0f);
-		float height = texture(uSamplerHeight, vsTexcoord).r;
+		float height = SampleHeight(uSamplerHeightMap, vsTexcoord).r;
 		vec2 halfOffset = normalize(viewdir).xy * (height * fBumpScale - bias);
 
 		for(int i = 0; i < 2; ++i)
 		{
-			height = (height + texture(uSamplerHeight, vsTexcoord + halfOffset).r) * 0.5;
+			height = (height + SampleHeight(uSamplerHeightMap, vsTexcoord + halfOffset).r) * 0.5;
 			halfOffset = normalize(viewdir).xy * (height * fBumpScale - bias);
 		}
 
 		texCoord = vsTexcoord + halfOffset;
 	}
+#endif
 
-	vec4 diff = texture(uSamplerDiffuse, texCoord);
+	vec4 diff = SampleDiffuse(uSamplerDiffuse, texCoord);
 	outColor = diff;
 
 	// Sponza-spesific: mask is in diffuse alpha
@@ -75,20 +72,20 @@ void main()
 
 	vec3 normal = vsNormal;
 
-	if (materialHasNormalMap && normalMappingEnabled)
+#if defined(HAS_NORMAL_MAP) && defined(NORMAL_MAPPING)
 	{
 		// Extract normal from normal map
 
-		vec3 normalTex = texture(uSamplerNormal, texCoord).rgb;
+		vec3 normalTex = SampleNormal(uSamplerNormalMap, texCoord).rgb;
 		normalTex = (2.0 * normalTex) - vec3(1.0);
 		normal = normalize(ComputeTBN() * normalTex);
 	}
-	else if (materialHasHeightMap && normalMappingEnabled)
+#elif defined(HAS_HEIGHT_MAP) && defined(NORMAL_MAPPING)
 	{
 		// Calculate new normal from height map using a Sobel filter
 		// Adapted to GLSL from http://content.gpwiki.org/D3DBook:(Lighting)_Per-Pixel_Lighting
 
-		vec2 vPixelSize = vec2(1, 1)/textureSize(uSamplerHeight, 0);
+		vec2 vPixelSize = vec2(1, 1)/HeightSize(uSamplerHeightMap);
 
 		// Compute the necessary offsets:
 		vec2 o00 = texCoord + vec2( -vPixelSize.x, -vPixelSize.y );
@@ -104,16 +101,16 @@ void main()
  
 		// Use of the sobel filter requires the eight samples
 		// surrounding the current pixel:
-		float h00 = texture(uSamplerHeight, o00 ).r;
-		float h10 = texture(uSamplerHeight, o10 ).r;
-		float h20 = texture(uSamplerHeight, o20 ).r;
+		float h00 = SampleHeight(uSamplerHeightMap, o00 ).r;
+		float h10 = SampleHeight(uSamplerHeightMap, o10 ).r;
+		float h20 = SampleHeight(uSamplerHeightMap, o20 ).r;
  
-		float h01 = texture(uSamplerHeight, o01 ).r;
-		float h21 = texture(uSamplerHeight, o21 ).r;
+		float h01 = SampleHeight(uSamplerHeightMap, o01 ).r;
+		float h21 = SampleHeight(uSamplerHeightMap, o21 ).r;
  
-		float h02 = texture(uSamplerHeight, o02 ).r;
-		float h12 = texture(uSamplerHeight, o12 ).r;
-		float h22 = texture(uSamplerHeight, o22 ).r;
+		float h02 = SampleHeight(uSamplerHeightMap, o02 ).r;
+		float h12 = SampleHeight(uSamplerHeightMap, o12 ).r;
+		float h22 = SampleHeight(uSamplerHeightMap, o22 ).r;
  
 		// Evaluate the Sobel filters
 		float Gx = h00 - h20 + 2.0f * h01 - 2.0f * h21 + h02 - h22;
@@ -125,6 +122,7 @@ void main()
 		// Make sure the returned normal is of unit length
  		normal = normalize( ComputeTBN() *  vec3( 2.0f * Gx, 2.0f * Gy, Gz ) );
 	}
+#endif
 	
 	outNormal = encodeNormal(normal);
 
@@ -0,0 +1,7 @@
+#version 430 core
+
+// Only depth-tested for occlusion queries; color- and depth-writes are masked off
+
+void main()
+{
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#version 430 core
+
+layout(location = 0) in vec3 position;
+
+@ubo.inc // PerFrame
+
+void main()
+{
+	gl_Position = PerFrame.proj * PerFrame.view * PerDraw.modelMatrix * vec4(position, 1.0);
+}
\ No newline at end of file
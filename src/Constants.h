@@ -13,4 +13,9 @@ namespace Constants
 	static const uint16_t MATERIAL_NORMAL_TEX_UNIT = 1;
 	static const uint16_t MATERIAL_HEIGHT_TEX_UNIT = 2;
 	static const uint16_t MATERIAL_SPECULAR_TEX_UNIT = 3;
+
+	// Texture arrays shared between materials (layer is in the MaterialUBO)
+	static const uint16_t MATERIAL_DIFF_ARRAY_TEX_UNIT = 4;
+	static const uint16_t MATERIAL_NORMAL_ARRAY_TEX_UNIT = 5;
+	static const uint16_t MATERIAL_HEIGHT_ARRAY_TEX_UNIT = 6;
 }
\ No newline at end of file
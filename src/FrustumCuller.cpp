@@ -1,7 +1,108 @@
 #include "FrustumCuller.h"
+#include "ThreadPool.h"
+
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
 
 #include "glm/glm.hpp"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#define TE_CULL_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TE_CULL_SSE 1
+#endif
+
+const size_t FrustumCuller::CHUNK_SIZE;
+const size_t FrustumCuller::LEAF_SIZE;
+const uint32_t FrustumCuller::TASK_DEPTH;
+const uint32_t FrustumCuller::PADDING;
+
+#if TE_CULL_AVX
+const size_t FrustumCuller::SIMD_WIDTH = 8;
+#elif TE_CULL_SSE
+const size_t FrustumCuller::SIMD_WIDTH = 4;
+#else
+const size_t FrustumCuller::SIMD_WIDTH = 1;
+#endif
+
+const float FrustumCuller::MAX_COHERENT_MOTION = 0.05f;
+
+namespace
+{
+	// Stored as the result of visible spheres, instead of a plane
+	const float VISIBLE = 6.0f;
+
+	// The operations culling needs, on SIMD_WIDTH floats at a time
+#if TE_CULL_AVX
+	typedef __m256 Floats;
+	typedef __m256 Mask;
+
+	inline Floats Load(const float* p) { return _mm256_loadu_ps(p); }
+	inline void Store(float* p, Floats a) { _mm256_storeu_ps(p, a); }
+	inline Floats Splat(float f) { return _mm256_set1_ps(f); }
+	inline Floats Add(Floats a, Floats b) { return _mm256_add_ps(a, b); }
+	inline Floats Sub(Floats a, Floats b) { return _mm256_sub_ps(a, b); }
+	inline Floats Mul(Floats a, Floats b) { return _mm256_mul_ps(a, b); }
+	inline Floats Min(Floats a, Floats b) { return _mm256_min_ps(a, b); }
+	inline Mask Less(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	inline Mask NotLess(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_NLT_UQ); }
+	inline Mask Greater(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	inline Mask Equal(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+	inline Mask And(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+	inline Mask AllTrue() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+	inline Floats Select(Mask m, Floats a, Floats b) { return _mm256_or_ps(_mm256_and_ps(m, a), _mm256_andnot_ps(m, b)); }
+	inline int Bits(Mask m) { return _mm256_movemask_ps(m); }
+#elif TE_CULL_SSE
+	typedef __m128 Floats;
+	typedef __m128 Mask;
+
+	inline Floats Load(const float* p) { return _mm_loadu_ps(p); }
+	inline void Store(float* p, Floats a) { _mm_storeu_ps(p, a); }
+	inline Floats Splat(float f) { return _mm_set1_ps(f); }
+	inline Floats Add(Floats a, Floats b) { return _mm_add_ps(a, b); }
+	inline Floats Sub(Floats a, Floats b) { return _mm_sub_ps(a, b); }
+	inline Floats Mul(Floats a, Floats b) { return _mm_mul_ps(a, b); }
+	inline Floats Min(Floats a, Floats b) { return _mm_min_ps(a, b); }
+	inline Mask Less(Floats a, Floats b) { return _mm_cmplt_ps(a, b); }
+	inline Mask NotLess(Floats a, Floats b) { return _mm_cmpnlt_ps(a, b); }
+	inline Mask Greater(Floats a, Floats b) { return _mm_cmpgt_ps(a, b); }
+	inline Mask Equal(Floats a, Floats b) { return _mm_cmpeq_ps(a, b); }
+	inline Mask And(Mask a, Mask b) { return _mm_and_ps(a, b); }
+	inline Mask AllTrue() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+	inline Floats Select(Mask m, Floats a, Floats b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+	inline int Bits(Mask m) { return _mm_movemask_ps(m); }
+#else
+	typedef float Floats;
+	typedef bool Mask;
+
+	inline Floats Load(const float* p) { return *p; }
+	inline void Store(float* p, Floats a) { *p = a; }
+	inline Floats Splat(float f) { return f; }
+	inline Floats Add(Floats a, Floats b) { return a + b; }
+	inline Floats Sub(Floats a, Floats b) { return a - b; }
+	inline Floats Mul(Floats a, Floats b) { return a * b; }
+	inline Floats Min(Floats a, Floats b) { return b < a ? b : a; }
+	inline Mask Less(Floats a, Floats b) { return a < b; }
+	inline Mask NotLess(Floats a, Floats b) { return !(a < b); }
+	inline Mask Greater(Floats a, Floats b) { return a > b; }
+	inline Mask Equal(Floats a, Floats b) { return a == b; }
+	inline Mask And(Mask a, Mask b) { return a && b; }
+	inline Mask AllTrue() { return true; }
+	inline Floats Select(Mask m, Floats a, Floats b) { return m ? a : b; }
+	inline int Bits(Mask m) { return m; }
+#endif
+
+	// Signed distance of the spheres' centers from the planes, plus their radius
+	inline Floats Distance(Floats planeX, Floats planeY, Floats planeZ, Floats planeW, Floats x, Floats y, Floats z, Floats r)
+	{
+		const Floats d = Add(Mul(planeX, x), Mul(planeY, y));
+		return Add(Add(d, Mul(planeZ, z)), Add(planeW, r));
+	}
+}
+
 static float InvSqrt(float x)
 {
 	float xhalf;
@@ -118,3 +219,524 @@ void ExtractFrustumPlanes(const glm::mat4& viewProj, glm::vec4 planes[6])
 	planes[5].z *= t;
 	planes[5].w *= t;
 }
+
+
+void FrustumCuller::Resize(size_t numSpheres)
+{
+	m_numSpheres = numSpheres;
+	m_nodes.clear();
+	m_taskRoots.clear();
+
+	// Padding has a negative radius, so it's outside every plane
+	const size_t padded = (numSpheres + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	m_x.assign(padded, 0.0f);
+	m_y.assign(padded, 0.0f);
+	m_z.assign(padded, 0.0f);
+	m_radius.assign(padded, -FLT_MAX);
+
+	m_validUntil.assign(padded, -FLT_MAX);
+	m_lastResult.assign(padded, 0.0f);
+	m_coherent = false;
+
+	m_slotObject.assign(padded, PADDING);
+	m_objectSlot.resize(numSpheres);
+	for (uint32_t i = 0; i < numSpheres; ++i)
+	{
+		m_slotObject[i] = i;
+		m_objectSlot[i] = i;
+	}
+}
+
+void FrustumCuller::SetSphere(size_t index, const glm::vec3& center, float radius)
+{
+	const uint32_t slot = m_objectSlot[index];
+	m_x[slot] = center.x;
+	m_y[slot] = center.y;
+	m_z[slot] = center.z;
+	m_radius[slot] = radius;
+	m_coherent = false;
+}
+
+void FrustumCuller::Build()
+{
+	std::vector<glm::vec4> spheres(m_numSpheres);
+	std::vector<uint32_t> objects(m_numSpheres);
+	for (uint32_t i = 0; i < m_numSpheres; ++i)
+	{
+		const uint32_t slot = m_objectSlot[i];
+		spheres[i] = glm::vec4(m_x[slot], m_y[slot], m_z[slot], m_radius[slot]);
+		objects[i] = i;
+	}
+
+	m_nodes.clear();
+	m_taskRoots.clear();
+	m_slotObject.clear();
+
+	if (m_numSpheres > 0)
+		BuildNode(spheres, objects, 0, m_numSpheres, 0);
+
+	// Store the spheres in leaf-order
+	const size_t numSlots = m_slotObject.size();
+	m_x.resize(numSlots);
+	m_y.resize(numSlots);
+	m_z.resize(numSlots);
+	m_radius.resize(numSlots);
+	m_validUntil.assign(numSlots, -FLT_MAX);
+	m_lastResult.assign(numSlots, 0.0f);
+
+	for (uint32_t slot = 0; slot < numSlots; ++slot)
+	{
+		const uint32_t object = m_slotObject[slot];
+		const glm::vec4 sphere = object == PADDING ? glm::vec4(0.0f, 0.0f, 0.0f, -FLT_MAX) : spheres[object];
+
+		m_x[slot] = sphere.x;
+		m_y[slot] = sphere.y;
+		m_z[slot] = sphere.z;
+		m_radius[slot] = sphere.w;
+
+		if (object != PADDING)
+			m_objectSlot[object] = slot;
+	}
+
+	Refit();
+}
+
+uint32_t FrustumCuller::BuildNode(const std::vector<glm::vec4>& spheres, std::vector<uint32_t>& objects, size_t begin, size_t end, uint32_t depth)
+{
+	const uint32_t index = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.push_back(Node());
+	m_nodes[index].firstSlot = static_cast<uint32_t>(m_slotObject.size());
+	m_nodes[index].rightChild = 0;
+	m_nodes[index].lastCullingPlane = 0;
+	m_nodes[index].validUntil = -FLT_MAX;
+	m_nodes[index].inside = false;
+
+	const size_t count = end - begin;
+	if (depth == TASK_DEPTH || (depth < TASK_DEPTH && count <= LEAF_SIZE))
+		m_taskRoots.push_back(index);
+
+	if (count <= LEAF_SIZE)
+	{
+		m_slotObject.insert(m_slotObject.end(), objects.begin() + begin, objects.begin() + end);
+		m_slotObject.resize((m_slotObject.size() + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH, PADDING);
+	}
+	else
+	{
+		// Split at the median along the axis the centers are spread the most, keeping the left side's leaves full
+		glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+		for (size_t i = begin; i < end; ++i)
+		{
+			const glm::vec4& sphere = spheres[objects[i]];
+			const glm::vec3 center(sphere.x, sphere.y, sphere.z);
+			lo = glm::min(lo, center);
+			hi = glm::max(hi, center);
+		}
+
+		const glm::vec3 size = hi - lo;
+		const int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+
+		size_t half = (count / 2 + LEAF_SIZE - 1) / LEAF_SIZE * LEAF_SIZE;
+		if (half >= count)
+			half = count / 2;
+
+		std::nth_element(objects.begin() + begin, objects.begin() + begin + half, objects.begin() + end, [&](uint32_t a, uint32_t b)
+		{
+			return spheres[a][axis] < spheres[b][axis];
+		});
+
+		BuildNode(spheres, objects, begin, begin + half, depth + 1);
+		const uint32_t right = BuildNode(spheres, objects, begin + half, end, depth + 1);
+		m_nodes[index].rightChild = right;
+	}
+
+	m_nodes[index].numSlots = static_cast<uint32_t>(m_slotObject.size()) - m_nodes[index].firstSlot;
+	return index;
+}
+
+void FrustumCuller::Refit()
+{
+	m_coherent = false;
+
+	// Children come after their parents
+	for (size_t i = m_nodes.size(); i-- > 0;)
+	{
+		Node& node = m_nodes[i];
+		glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+
+		if (node.rightChild == 0)
+		{
+			for (uint32_t slot = node.firstSlot; slot < node.firstSlot + node.numSlots; ++slot)
+			{
+				if (m_slotObject[slot] == PADDING)
+					continue;
+
+				const glm::vec3 center(m_x[slot], m_y[slot], m_z[slot]);
+				lo = glm::min(lo, center - glm::vec3(m_radius[slot]));
+				hi = glm::max(hi, center + glm::vec3(m_radius[slot]));
+			}
+		}
+		else
+		{
+			const Node& left = m_nodes[i + 1];
+			const Node& right = m_nodes[node.rightChild];
+			lo = glm::min(left.center - left.extents, right.center - right.extents);
+			hi = glm::max(left.center + left.extents, right.center + right.extents);
+		}
+
+		// Grown a little, so rounding doesn't make a box cull a sphere that's visible when tested itself
+		node.center = (lo + hi) * 0.5f;
+		node.extents = (hi - lo) * 0.5f + (glm::abs(lo) + glm::abs(hi)) * 1e-5f;
+	}
+}
+
+void FrustumCuller::Cull(VisibleList& visible, const glm::mat4& viewProj, ThreadPool* threadPool, bool computeDepths)
+{
+	glm::vec4 frustumPlanes[6];
+	ExtractFrustumPlanes(viewProj, frustumPlanes);
+
+	UpdateMotion(frustumPlanes);
+	m_stats = Stats();
+
+	// Each task writes to the part of the list matching its slots, which is then compacted in order
+	const size_t numSlots = m_radius.size();
+	if (visible.indices.size() < numSlots)
+		visible.indices.resize(numSlots);
+
+	uint32_t* out = visible.indices.data();
+	visible.count = 0;
+
+	uint32_t numTasks = 0;
+	if (!m_nodes.empty())
+	{
+		numTasks = static_cast<uint32_t>(m_taskRoots.size());
+
+		if (!threadPool || numTasks <= 1)
+		{
+			visible.count = CullNode(frustumPlanes, 0, 0x3F, FLT_MAX, out, m_stats);
+			numTasks = 0;
+		}
+		else
+		{
+			m_taskCounts.resize(numTasks);
+			m_taskStats.assign(numTasks, Stats());
+
+			threadPool->Run(numTasks, [&](uint32_t task)
+			{
+				const uint32_t root = m_taskRoots[task];
+				m_taskCounts[task] = CullNode(frustumPlanes, root, 0x3F, FLT_MAX, out + m_nodes[root].firstSlot, m_taskStats[task]);
+			});
+
+			for (uint32_t task = 0; task < numTasks; ++task)
+			{
+				const uint32_t* first = out + m_nodes[m_taskRoots[task]].firstSlot;
+				std::copy(first, first + m_taskCounts[task], out + visible.count);
+				visible.count += m_taskCounts[task];
+			}
+		}
+	}
+	else
+	{
+		numTasks = static_cast<uint32_t>((numSlots + CHUNK_SIZE - 1) / CHUNK_SIZE);
+
+		if (!threadPool || numTasks <= 1)
+		{
+			visible.count = CullRange(frustumPlanes, 0x3F, FLT_MAX, 0, numSlots, out, m_stats);
+			numTasks = 0;
+		}
+		else
+		{
+			m_taskCounts.resize(numTasks);
+			m_taskStats.assign(numTasks, Stats());
+
+			threadPool->Run(numTasks, [&](uint32_t chunk)
+			{
+				const size_t begin = chunk * CHUNK_SIZE;
+				m_taskCounts[chunk] = CullRange(frustumPlanes, 0x3F, FLT_MAX, begin, std::min(begin + CHUNK_SIZE, numSlots), out + begin, m_taskStats[chunk]);
+			});
+
+			for (uint32_t chunk = 0; chunk < numTasks; ++chunk)
+			{
+				const uint32_t* first = out + chunk * CHUNK_SIZE;
+				std::copy(first, first + m_taskCounts[chunk], out + visible.count);
+				visible.count += m_taskCounts[chunk];
+			}
+		}
+	}
+
+	for (uint32_t task = 0; task < numTasks; ++task)
+	{
+		m_stats.planeTests += m_taskStats[task].planeTests;
+		m_stats.reusedSpheres += m_taskStats[task].reusedSpheres;
+		m_stats.reusedNodes += m_taskStats[task].reusedNodes;
+	}
+
+	if (computeDepths)
+	{
+		if (visible.depths.size() < numSlots)
+			visible.depths.resize(numSlots);
+
+		// Clip-space w, which is the view-space depth for perspective projections
+		const glm::vec4 row(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+		for (uint32_t i = 0; i < visible.count; ++i)
+		{
+			const uint32_t slot = m_objectSlot[out[i]];
+			visible.depths[i] = row.x * m_x[slot] + row.y * m_y[slot] + row.z * m_z[slot] + row.w;
+		}
+	}
+}
+
+void FrustumCuller::UpdateMotion(const glm::vec4 frustumPlanes[6])
+{
+	bool coherent = m_coherent;
+
+	if (!m_coherent)
+	{
+		// Bounds of everything, so the distance of any point from a plane can't change by more than
+		// |n' - n| * m_sceneRadius + |d'(m_sceneCenter) - d(m_sceneCenter)|
+		glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+		if (!m_nodes.empty())
+		{
+			lo = m_nodes[0].center - m_nodes[0].extents;
+			hi = m_nodes[0].center + m_nodes[0].extents;
+		}
+		else
+		{
+			for (size_t slot = 0; slot < m_radius.size(); ++slot)
+			{
+				if (m_slotObject[slot] == PADDING)
+					continue;
+
+				const glm::vec3 center(m_x[slot], m_y[slot], m_z[slot]);
+				lo = glm::min(lo, center - glm::vec3(m_radius[slot]));
+				hi = glm::max(hi, center + glm::vec3(m_radius[slot]));
+			}
+		}
+
+		m_sceneCenter = m_numSpheres > 0 ? (lo + hi) * 0.5f : glm::vec3(0.0f);
+		m_sceneRadius = m_numSpheres > 0 ? glm::length(hi - lo) * 0.5f : 0.0f;
+		m_coherent = true;
+	}
+	else
+	{
+		float motion = 0.0f;
+		for (int p = 0; p < 6; ++p)
+		{
+			const glm::vec4 delta = frustumPlanes[p] - m_lastPlanes[p];
+			const glm::vec3 normal(delta.x, delta.y, delta.z);
+			motion = std::max(motion, glm::length(normal) * m_sceneRadius + std::fabs(glm::dot(normal, m_sceneCenter) + delta.w));
+		}
+
+		// Results are unlikely to stay valid after moving further than this
+		coherent = motion <= MAX_COHERENT_MOTION * m_sceneRadius && m_motion + motion <= m_sceneRadius;
+		m_motion += motion;
+	}
+
+	m_reuse = coherent;
+	if (!coherent)
+	{
+		m_motion = 0.0f;
+		std::fill(m_validUntil.begin(), m_validUntil.end(), -FLT_MAX);
+		for (Node& node : m_nodes)
+			node.validUntil = -FLT_MAX;
+	}
+
+	float maxW = 0.0f;
+	for (int p = 0; p < 6; ++p)
+	{
+		m_lastPlanes[p] = frustumPlanes[p];
+		maxW = std::max(maxW, std::fabs(frustumPlanes[p].w));
+	}
+
+	m_epsilon = (glm::length(m_sceneCenter) + m_sceneRadius + maxW) * 1e-5f;
+}
+
+uint32_t FrustumCuller::CullNode(const glm::vec4 frustumPlanes[6], uint32_t nodeIndex, uint32_t planeMask, float slack, uint32_t* out, Stats& stats)
+{
+	Node& node = m_nodes[nodeIndex];
+
+	if (node.validUntil > m_motion)
+	{
+		++stats.reusedNodes;
+		return node.inside ? EmitNode(node, out) : 0;
+	}
+
+	// The plane that culled the node last is tested first, then the rest in order
+	const uint32_t first = node.lastCullingPlane;
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		const uint32_t p = i == 0 ? first : (i <= first ? i - 1 : i);
+		if (!(planeMask & (1u << p)))
+			continue;
+
+		const glm::vec4& plane = frustumPlanes[p];
+		const float d = plane.x * node.center.x + plane.y * node.center.y + plane.z * node.center.z + plane.w;
+		const float r = fabs(plane.x) * node.extents.x + fabs(plane.y) * node.extents.y + fabs(plane.z) * node.extents.z;
+		++stats.planeTests;
+
+		if (d + r < 0.0f)
+		{
+			node.lastCullingPlane = p;
+			node.validUntil = m_motion - (d + r) - m_epsilon;
+			node.inside = false;
+			return 0;
+		}
+
+		// Completely inside this plane, so is everything below
+		if (d - r >= 0.0f)
+		{
+			planeMask &= ~(1u << p);
+			slack = std::min(slack, d - r);
+		}
+	}
+
+	if (planeMask == 0)
+	{
+		node.validUntil = m_motion + slack - m_epsilon;
+		node.inside = true;
+		return EmitNode(node, out);
+	}
+
+	node.validUntil = -FLT_MAX;
+
+	if (node.rightChild == 0)
+		return CullRange(frustumPlanes, planeMask, slack, node.firstSlot, node.firstSlot + node.numSlots, out, stats);
+
+	const uint32_t count = CullNode(frustumPlanes, nodeIndex + 1, planeMask, slack, out, stats);
+	return count + CullNode(frustumPlanes, node.rightChild, planeMask, slack, out + count, stats);
+}
+
+uint32_t FrustumCuller::EmitNode(const Node& node, uint32_t* out) const
+{
+	uint32_t count = 0;
+	for (uint32_t slot = node.firstSlot; slot < node.firstSlot + node.numSlots; ++slot)
+	{
+		if (m_slotObject[slot] != PADDING)
+			out[count++] = m_slotObject[slot];
+	}
+
+	return count;
+}
+
+uint32_t FrustumCuller::CullRange(const glm::vec4 frustumPlanes[6], uint32_t planeMask, float slack, size_t begin, size_t end, uint32_t* out, Stats& stats)
+{
+	Floats planeX[6], planeY[6], planeZ[6], planeW[6];
+	float planeIndex[6];
+	int numPlanes = 0;
+	for (int p = 0; p < 6; ++p)
+	{
+		if (!(planeMask & (1u << p)))
+			continue;
+
+		planeX[numPlanes] = Splat(frustumPlanes[p].x);
+		planeY[numPlanes] = Splat(frustumPlanes[p].y);
+		planeZ[numPlanes] = Splat(frustumPlanes[p].z);
+		planeW[numPlanes] = Splat(frustumPlanes[p].w);
+		planeIndex[numPlanes] = static_cast<float>(p);
+		++numPlanes;
+	}
+
+	const int allLanes = (1 << SIMD_WIDTH) - 1;
+	const Floats zero = Splat(0.0f);
+	const Floats visibleResult = Splat(VISIBLE);
+	const Floats motion = Splat(m_motion);
+	const Floats epsilon = Splat(m_epsilon);
+	const Floats outsideAll = Splat(-FLT_MAX);
+
+	uint32_t count = 0;
+	for (size_t i = begin; i < end; i += SIMD_WIDTH)
+	{
+		const Floats lastResult = Load(&m_lastResult[i]);
+		int visible;
+
+		if (m_reuse && Bits(Greater(Load(&m_validUntil[i]), motion)) == allLanes)
+		{
+			// The planes haven't moved far enough to change any of these
+			visible = Bits(Equal(lastResult, visibleResult));
+			stats.reusedSpheres += static_cast<uint32_t>(SIMD_WIDTH);
+		}
+		else
+		{
+			const Floats x = Load(&m_x[i]);
+			const Floats y = Load(&m_y[i]);
+			const Floats z = Load(&m_z[i]);
+			const Floats r = Load(&m_radius[i]);
+
+			// If all were culled, they're most likely still outside the planes that culled them
+			if (m_reuse && Bits(Less(lastResult, visibleResult)) == allLanes)
+			{
+				float lastX[8], lastY[8], lastZ[8], lastW[8];
+				for (size_t j = 0; j < SIMD_WIDTH; ++j)
+				{
+					const glm::vec4& plane = frustumPlanes[static_cast<int>(m_lastResult[i + j])];
+					lastX[j] = plane.x;
+					lastY[j] = plane.y;
+					lastZ[j] = plane.z;
+					lastW[j] = plane.w;
+				}
+
+				const Floats d = Distance(Load(lastX), Load(lastY), Load(lastZ), Load(lastW), x, y, z, r);
+				stats.planeTests += static_cast<uint32_t>(SIMD_WIDTH);
+
+				if (Bits(Less(d, zero)) == allLanes)
+				{
+					Store(&m_validUntil[i], Sub(Sub(motion, d), epsilon));
+					continue;
+				}
+			}
+
+			// Visible unless (dot(plane, center) + radius < 0) for any of the planes, as in InFrustum().
+			// Visible spheres stay so until the nearest plane reaches them, culled ones until the furthest one does.
+			Mask isVisible = AllTrue();
+			Floats inside = Splat(slack);
+			Floats outside = outsideAll;
+			Floats culling = zero;
+#if TE_CULL_AVX || TE_CULL_SSE
+			for (int p = 0; p < numPlanes; ++p)
+			{
+				const Floats d = Distance(planeX[p], planeY[p], planeZ[p], planeW[p], x, y, z, r);
+				isVisible = And(isVisible, NotLess(d, zero));
+				inside = Min(inside, d);
+
+				const Floats distance = Sub(zero, d);
+				const Mask further = Greater(distance, outside);
+				outside = Select(further, distance, outside);
+				culling = Select(further, Splat(planeIndex[p]), culling);
+			}
+
+			stats.planeTests += static_cast<uint32_t>(SIMD_WIDTH) * numPlanes;
+#else
+			// A single sphere stops at the first plane culling it, and stays culled until that plane reaches it
+			int tested = 0;
+			while (tested < numPlanes)
+			{
+				const int p = tested++;
+				const Floats d = Distance(planeX[p], planeY[p], planeZ[p], planeW[p], x, y, z, r);
+
+				if (d < 0.0f)
+				{
+					isVisible = false;
+					outside = -d;
+					culling = planeIndex[p];
+					break;
+				}
+
+				inside = Min(inside, d);
+			}
+
+			stats.planeTests += static_cast<uint32_t>(tested);
+#endif
+			Store(&m_lastResult[i], Select(isVisible, visibleResult, culling));
+			Store(&m_validUntil[i], Sub(Add(motion, Select(isVisible, inside, outside)), epsilon));
+			visible = Bits(isVisible);
+		}
+
+		// Written without branching; 'out' has room for all of the range, and padding is never visible
+		for (size_t j = 0; j < SIMD_WIDTH; ++j)
+		{
+			out[count] = m_slotObject[i + j];
+			count += (visible >> j) & 1;
+		}
+	}
+
+	return count;
+}
\ No newline at end of file
@@ -1,31 +1,93 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
 #include "glm/glm.hpp"
 
+class ThreadPool;
+
 extern void ExtractFrustumPlanes(const glm::mat4& viewProj, glm::vec4 planes[6]);
 
-template<typename T>
+// Culls bounding spheres against the view-frustum. The spheres are kept in structure-of-arrays form
+// and tested several at a time against all planes: 8 with AVX, 4 with SSE, otherwise one by one.
+//
+// Build() puts them in a bounding volume hierarchy of boxes, with each leaf's spheres stored together.
+// Subtrees outside a plane are skipped, and planes a subtree is completely inside aren't tested
+// further down. Each node remembers the plane that last culled it, and tests it first next time.
+//
+// Results are reused between frames: each sphere and node remembers whether it was visible, which plane
+// culled it, and how far the planes can move before that could change. While the camera moves little,
+// only spheres near the edges of the frustum are tested again, and culled ones against their last plane.
 class FrustumCuller
 {
 public:
-	// Culls anything with GetPosition() --> glm::vec3, and GetRadius() --> float
-	void Cull(std::vector<T>& cullables, std::vector<bool>& isCulledVector, const glm::mat4& viewProj)
+	// Copies the bounds of anything with GetPosition() --> glm::vec3, and GetRadius() --> float,
+	// and builds the hierarchy. Results are indexed like 'cullables'.
+	template<typename T>
+	void SetSpheres(const std::vector<T>& cullables)
 	{
-		isCulledVector.clear();
-		isCulledVector.resize(cullables.size());
+		Resize(cullables.size());
 
-		glm::vec4 frustumPlanes[6];
-		ExtractFrustumPlanes(viewProj, frustumPlanes);
+		for (size_t i = 0; i < cullables.size(); ++i)
+			SetSphere(i, cullables[i].GetPosition(), cullables[i].GetRadius());
 
-		size_t numItems = cullables.size();
-		for (size_t i = 0; i < numItems; ++i)
-		{
-			T& object = cullables[i];
-			isCulledVector[i] = !InFrustum(frustumPlanes, object.GetPosition(), object.GetRadius());
-		}
+		Build();
+	}
+
+	// Removes the hierarchy; spheres are tested one batch after another until the next Build()
+	void Resize(size_t numSpheres);
+
+	// Call Refit() after moving spheres, or Build() if they've moved far
+	void SetSphere(size_t index, const glm::vec3& center, float radius);
+
+	void Build();
+	void Refit();
+
+	size_t GetNumSpheres() const
+	{
+		return m_numSpheres;
+	}
+
+	// Center and radius
+	glm::vec4 GetSphere(size_t index) const
+	{
+		const uint32_t slot = m_objectSlot[index];
+		return glm::vec4(m_x[slot], m_y[slot], m_z[slot], m_radius[slot]);
+	}
+
+	// Indices of the spheres inside the frustum, and optionally the depth of their centers in view-space.
+	// Has room for all spheres, so culling doesn't allocate after the first frame.
+	struct VisibleList
+	{
+		std::vector<uint32_t> indices; // The first 'count' are valid
+		std::vector<float> depths;
+		uint32_t count = 0;
+
+		uint32_t* begin() { return indices.data(); }
+		uint32_t* end() { return indices.data() + count; }
+		const uint32_t* begin() const { return indices.data(); }
+		const uint32_t* end() const { return indices.data() + count; }
+	};
+
+	// Indices are in ascending order without a hierarchy, otherwise in the order of its leaves. If given
+	// a thread-pool, the spheres are split into chunks (or subtrees) culled by its threads, without
+	// changing the order.
+	void Cull(VisibleList& visible, const glm::mat4& viewProj, ThreadPool* threadPool = nullptr, bool computeDepths = false);
+
+	struct Stats
+	{
+		uint32_t planeTests = 0;    // Spheres and boxes tested against a plane
+		uint32_t reusedSpheres = 0; // Spheres not tested, as they couldn't have changed since last frame (with padding)
+		uint32_t reusedNodes = 0;   // Same for subtrees
+	};
+
+	// Of the last Cull(); testing every sphere against every plane would take 6 * GetNumSpheres() tests
+	const Stats& GetStats() const
+	{
+		return m_stats;
 	}
 
+	// Tests a single sphere
 	static bool InFrustum(const glm::vec4 frustumPlanes[], const glm::vec3 point, float radius)
 	{
 		const glm::vec4 p = glm::vec4(point, 1.0f);
@@ -40,4 +102,75 @@ public:
 
 		return true;
 	}
+
+	// Spheres tested at once
+	static const size_t SIMD_WIDTH;
+
+	// Spheres per thread-pool task without a hierarchy (a multiple of SIMD_WIDTH)
+	static const size_t CHUNK_SIZE = 2048;
+
+	// Most spheres per leaf
+	static const size_t LEAF_SIZE = 8;
+
+	// Subtrees this deep are culled as separate thread-pool tasks
+	static const uint32_t TASK_DEPTH = 5;
+
+	// How far the planes can move in a frame, relative to the size of the scene, for results to be reused
+	static const float MAX_COHERENT_MOTION;
+
+private:
+	struct Node
+	{
+		glm::vec3 center;
+		glm::vec3 extents;
+		uint32_t firstSlot;
+		uint32_t numSlots;
+		uint32_t rightChild; // 0 for leaves; the left child follows its parent
+		uint32_t lastCullingPlane;
+		float validUntil; // See m_validUntil
+		bool inside;      // Otherwise outside, while still valid
+	};
+
+	uint32_t BuildNode(const std::vector<glm::vec4>& spheres, std::vector<uint32_t>& objects, size_t begin, size_t end, uint32_t depth);
+	// Write the indices of visible spheres to 'out', returning how many
+	// 'slack' is how far the planes not in 'planeMask' can move before the spheres are outside them.
+	uint32_t CullNode(const glm::vec4 frustumPlanes[6], uint32_t nodeIndex, uint32_t planeMask, float slack, uint32_t* out, Stats& stats);
+	uint32_t CullRange(const glm::vec4 frustumPlanes[6], uint32_t planeMask, float slack, size_t begin, size_t end, uint32_t* out, Stats& stats);
+	uint32_t EmitNode(const Node& node, uint32_t* out) const;
+
+	// Adds up how far the planes have moved since the last frame, or forgets earlier results
+	void UpdateMotion(const glm::vec4 frustumPlanes[6]);
+
+	static const uint32_t PADDING = ~0u;
+
+	// By slot: leaves are padded to a multiple of the SIMD-width with spheres that are always culled
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_z;
+	std::vector<float> m_radius;
+	std::vector<uint32_t> m_slotObject; // PADDING for padding
+	std::vector<uint32_t> m_objectSlot;
+	size_t m_numSpheres = 0;
+
+	// By slot: the results are still valid while m_motion is less than m_validUntil
+	std::vector<float> m_validUntil;
+	std::vector<float> m_lastResult; // The plane that culled the sphere, or 6 if visible
+
+	// Pre-order; empty without a hierarchy
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_taskRoots;
+
+	// Visible spheres found by each thread-pool task
+	std::vector<uint32_t> m_taskCounts;
+	std::vector<Stats> m_taskStats;
+	Stats m_stats;
+
+	// How far the planes have moved in total since results were last forgotten, bounded over the whole scene
+	glm::vec4 m_lastPlanes[6];
+	glm::vec3 m_sceneCenter;
+	float m_sceneRadius = 0.0f;
+	float m_motion = 0.0f;
+	float m_epsilon = 0.0f; // Margins are reduced by this, in case of rounding
+	bool m_coherent = false; // False after the spheres change
+	bool m_reuse = false;    // Whether this frame can use the last one's results
 };
\ No newline at end of file
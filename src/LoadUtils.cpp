@@ -8,10 +8,12 @@
 #include "graphics/RenderingSystem.h"
 
 #include "Renderable.h"
+#include "TransformStore.h"
 #include "Material.h"
 #include "SceneLoader.h"
 #include "TextureLoader.h"
 #include "UBOsAndMesh.h"
+#include "OcclusionCuller.h"
 
 namespace
 {
@@ -20,7 +22,39 @@ namespace
 	const float LOAD_POSITION_SCALE = 0.01f;
 	const float LOAD_DEFAULT_SCALE = 0.01f;
 
-	Material CreateMaterial(const SceneLoader::MaterialInfo& materialInfo, Graphics::RenderingSystem& renderingSystem, TextureLoader& textureLoader)
+	// Same-size/same-type material textures share 2D texture arrays, so materials differ only by their UBO
+	const bool LOAD_INTO_TEXTURE_ARRAYS = true;
+
+	// Unless the scene says otherwise, meshes at least this large (world-space bounding radius) and with at most
+	// this many triangles are software occluders. Detailed meshes cost more to rasterize than they hide.
+	// Meshes whose diffuse texture has alpha aren't, as the G-buffer shader discards where it's below 0.5.
+	const float OCCLUDER_MIN_RADIUS = 2.0f;
+	const uint32_t OCCLUDER_MAX_TRIANGLES = 20000;
+
+	// Position, texcoords, normal, tangent, bitangent
+	const uint32_t VERTEX_STRIDE = 14 * sizeof(float);
+
+	// Schedules a texture either as a layer in a shared array or as a separate 2D-texture (also the fallback).
+	// Returns true if it was placed in an array.
+	bool ScheduleTexture(const std::string& dataPrefix, const std::string& imageFile, Graphics::TextureType type, 
+		Graphics::RenderingSystem& renderingSystem, TextureLoader& textureLoader,
+		Graphics::Texture2DHandle& outHandle, Graphics::Texture2DArrayHandle& outArrayHandle, glm::uint& outLayer)
+	{
+		TextureLoader::ArrayLayer arrayLayer;
+
+		if (LOAD_INTO_TEXTURE_ARRAYS && textureLoader.ScheduleArrayLayer(renderingSystem, dataPrefix, imageFile, type, arrayLayer))
+		{
+			outArrayHandle = arrayLayer.handle;
+			outLayer = arrayLayer.layer;
+			return true;
+		}
+
+		outHandle = renderingSystem.CreateTexture2D();
+		textureLoader.Schedule({ outHandle, imageFile, type });
+		return false;
+	}
+
+	Material CreateMaterial(const std::string& dataPrefix, const SceneLoader::MaterialInfo& materialInfo, Graphics::RenderingSystem& renderingSystem, TextureLoader& textureLoader)
 	{
 		MaterialUBO materialBufferUBO;
 
@@ -29,38 +63,51 @@ namespace
 		Graphics::Texture2DHandle normalTexHandle   = Graphics::Texture2DHandle::Invalid();
 		Graphics::Texture2DHandle heightTexHandle   = Graphics::Texture2DHandle::Invalid();
 
+		Graphics::Texture2DArrayHandle diffArrayHandle   = Graphics::Texture2DArrayHandle::Invalid();
+		Graphics::Texture2DArrayHandle normalArrayHandle = Graphics::Texture2DArrayHandle::Invalid();
+		Graphics::Texture2DArrayHandle heightArrayHandle = Graphics::Texture2DArrayHandle::Invalid();
+
 		if (materialInfo.diffuseTexture != "")
 		{
 			// Load as SRGB
-			diffTexHandle = renderingSystem.CreateTexture2D();
-			textureLoader.Schedule({ diffTexHandle, materialInfo.diffuseTexture, Graphics::TextureType::SRGBA8 });
+			if (ScheduleTexture(dataPrefix, materialInfo.diffuseTexture, Graphics::TextureType::SRGBA8, renderingSystem, textureLoader, diffTexHandle, diffArrayHandle, materialBufferUBO.diffuseLayer))
+				materialBufferUBO.flags |= MaterialUBO::DiffuseInArray;
 		}
 
 		if (materialInfo.normalTexture != "")
 		{
 			// Load as RGB
-			normalTexHandle = renderingSystem.CreateTexture2D();
 			materialBufferUBO.flags |= MaterialUBO::HasNormalMap;
-			textureLoader.Schedule({ normalTexHandle, materialInfo.normalTexture, Graphics::TextureType::RGBA8 });
+			if (ScheduleTexture(dataPrefix, materialInfo.normalTexture, Graphics::TextureType::RGBA8, renderingSystem, textureLoader, normalTexHandle, normalArrayHandle, materialBufferUBO.normalLayer))
+				materialBufferUBO.flags |= MaterialUBO::NormalInArray;
 		}
 
 		if (materialInfo.heightTexture != "")
 		{
 			// Load as R8
-			heightTexHandle = renderingSystem.CreateTexture2D();
 			materialBufferUBO.flags |= MaterialUBO::HasHeightMap;
-			textureLoader.Schedule({ heightTexHandle, materialInfo.heightTexture, Graphics::TextureType::R8 });
+			if (ScheduleTexture(dataPrefix, materialInfo.heightTexture, Graphics::TextureType::R8, renderingSystem, textureLoader, heightTexHandle, heightArrayHandle, materialBufferUBO.heightLayer))
+				materialBufferUBO.flags |= MaterialUBO::HeightInArray;
 		}
 
 		// Create and upload material-UBO
 		materialBufferHandle = renderingSystem.CreateBuffer();
 		renderingSystem.UpdateBuffer(materialBufferHandle, &materialBufferUBO, sizeof(materialBufferUBO), Graphics::BufferType::STATIC);
 
-		return Material{ diffTexHandle, normalTexHandle, heightTexHandle, materialBufferHandle };
+		Material material{ diffTexHandle, normalTexHandle, heightTexHandle, diffArrayHandle, normalArrayHandle, heightArrayHandle, materialBufferHandle };
+
+		// Shader-features are the same bits as the UBO-flags
+		static_assert(uint32_t(MaterialUBO::HasNormalMap) == uint32_t(DeferredShaderFeature::HasNormalMap) && 
+			uint32_t(MaterialUBO::HeightInArray) == uint32_t(DeferredShaderFeature::HeightInArray), 
+			"MaterialUBO::Flags and DeferredShaderFeature must match");
+		material.SetShaderFeatures(materialBufferUBO.flags);
+
+		return material;
 	}
 }
 
-bool GetRenderables(const std::string& dataPrefix, TextureLoader& textureLoader, Graphics::RenderingSystem& renderingSystem, std::vector<Renderable>& outRenderables)
+bool GetRenderables(const std::string& dataPrefix, TextureLoader& textureLoader, Graphics::RenderingSystem& renderingSystem, std::vector<Renderable>& outRenderables,
+	TransformStore& outTransforms, OcclusionCuller* occlusionCuller)
 {
 	// Load scene
 	SceneLoader::SceneInfo sceneInfo;
@@ -83,7 +130,7 @@ bool GetRenderables(const std::string& dataPrefix, TextureLoader& textureLoader,
 	for (size_t index = 0; index < sceneInfo.materials.size(); ++index)
 	{
 		auto& materialInfo = sceneInfo.materials[index];
-		loadedMaterials.emplace(index, CreateMaterial(materialInfo, renderingSystem, textureLoader));		
+		loadedMaterials.emplace(index, CreateMaterial(dataPrefix, materialInfo, renderingSystem, textureLoader));		
 	}
 
 	// Load datafile
@@ -181,11 +228,24 @@ bool GetRenderables(const std::string& dataPrefix, TextureLoader& textureLoader,
 		}
 
 		// Create a renderable for this mesh
-		Renderable renderable(newMesh, material);
-		renderable.SetPosition(meshInfo.position * LOAD_POSITION_SCALE);
-		renderable.SetScale(LOAD_DEFAULT_SCALE);
+		const uint32_t transform = outTransforms.Add(meshInfo.position * LOAD_POSITION_SCALE, glm::quat(), LOAD_DEFAULT_SCALE);
+		outRenderables.push_back(Renderable(newMesh, material, transform));
 
-		outRenderables.push_back(renderable);
+		// Keep a copy of the positions for software occlusion-culling
+		if (occlusionCuller)
+		{
+			const uint32_t numTriangles = (meshInfo.numIndices ? meshInfo.numIndices : verticesDataSize / VERTEX_STRIDE) / 3;
+			const std::string& diffuseTexture = sceneInfo.materials[meshInfo.materialIndex].diffuseTexture;
+			const bool occluder = meshInfo.occluder != -1 ? meshInfo.occluder != 0 : 
+				newMesh.radius * outTransforms.GetScale(transform) >= OCCLUDER_MIN_RADIUS && numTriangles <= OCCLUDER_MAX_TRIANGLES &&
+				(diffuseTexture.empty() || !TextureLoader::MayHaveAlpha(dataPrefix + diffuseTexture));
+
+			if (occluder)
+			{
+				const uint32_t* indices = meshInfo.numIndices ? reinterpret_cast<const uint32_t*>(meshDataVector.data() + meshInfo.indexDataOffset) : nullptr;
+				occlusionCuller->AddOccluder(verticesDataAddress, VERTEX_STRIDE, verticesDataSize / VERTEX_STRIDE, indices, meshInfo.numIndices, outTransforms.ComputeWorldMatrix(transform));
+			}
+		}
 
 		// Poll at regular intervals
 		if (index % 100 == 0)
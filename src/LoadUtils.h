@@ -6,6 +6,11 @@
 // Forward decls.
 class TextureLoader;
 class Renderable;
+class TransformStore;
+class OcclusionCuller;
 #include "graphics/ForwardDecl.h"
 
-extern bool GetRenderables(const std::string& dataPrefix, TextureLoader& textureLoader, Graphics::RenderingSystem& renderingSystem, std::vector<Renderable>& outRenderables);
\ No newline at end of file
+// The renderables' transforms are added to 'outTransforms'. Meshes used for software occlusion-culling are
+// added to 'occlusionCuller' if given.
+extern bool GetRenderables(const std::string& dataPrefix, TextureLoader& textureLoader, Graphics::RenderingSystem& renderingSystem, std::vector<Renderable>& outRenderables,
+	TransformStore& outTransforms, OcclusionCuller* occlusionCuller = nullptr);
\ No newline at end of file
@@ -9,4 +9,13 @@ void Material::Bind(Graphics::RenderingSystem& rs) const
 	rs.BindTexture2D(Constants::MATERIAL_DIFF_TEX_UNIT, m_diffuseTextureHandle);
 	rs.BindTexture2D(Constants::MATERIAL_HEIGHT_TEX_UNIT, m_heightMapTextureHandle);
 	rs.BindTexture2D(Constants::MATERIAL_NORMAL_TEX_UNIT, m_normalMapTextureHandle);
+
+	if (m_diffuseArrayHandle.IsValid())
+		rs.BindTexture2DArray(Constants::MATERIAL_DIFF_ARRAY_TEX_UNIT, m_diffuseArrayHandle);
+
+	if (m_heightMapArrayHandle.IsValid())
+		rs.BindTexture2DArray(Constants::MATERIAL_HEIGHT_ARRAY_TEX_UNIT, m_heightMapArrayHandle);
+
+	if (m_normalMapArrayHandle.IsValid())
+		rs.BindTexture2DArray(Constants::MATERIAL_NORMAL_ARRAY_TEX_UNIT, m_normalMapArrayHandle);
 }
\ No newline at end of file
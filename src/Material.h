@@ -5,6 +5,40 @@
 #include "graphics/ForwardDecl.h"
 #include "graphics/Handles.h"
 
+// Features the deferred (G-buffer) shader is specialized for, as indices into the ShaderVariants-mask.
+// The material-features match MaterialUBO::Flags; the rest are toggled globally.
+namespace DeferredShaderFeature
+{
+	enum : uint32_t
+	{
+		HasNormalMap    = 1 << 0,
+		HasHeightMap    = 1 << 1,
+		DiffuseInArray  = 1 << 2,
+		NormalInArray   = 1 << 3,
+		HeightInArray   = 1 << 4,
+		NormalMapping   = 1 << 5,
+		ParallaxMapping = 1 << 6,
+
+		MaterialFeatures = (1 << 5) - 1,
+	};
+
+	// Defines, in bit-order
+	static const char* const defines[] = { "HAS_NORMAL_MAP", "HAS_HEIGHT_MAP", "DIFFUSE_IN_ARRAY", "NORMAL_IN_ARRAY", "HEIGHT_IN_ARRAY", "NORMAL_MAPPING", "PARALLAX_MAPPING" };
+
+	// The variant-mask for a material; global features that make no difference without the material's 
+	// maps (see deferred.fs) are dropped, so such materials don't get identical variants for them
+	inline uint32_t Combine(uint32_t materialFeatures, uint32_t globalFeatures)
+	{
+		if (!(materialFeatures & (HasNormalMap | HasHeightMap)))
+			globalFeatures &= ~NormalMapping;
+
+		if (!(materialFeatures & HasHeightMap))
+			globalFeatures &= ~ParallaxMapping;
+
+		return materialFeatures | globalFeatures;
+	}
+}
+
 class Material
 {
 public:
@@ -15,6 +49,20 @@ public:
 				: m_diffuseTextureHandle(diffuse), m_normalMapTextureHandle(normal), m_heightMapTextureHandle(height), m_uniformBuffer(uniformBuffer)
 	{};
 
+	// Textures in arrays are used instead of the corresponding 2D-texture if valid
+	// (with the layer given in the material's UBO).
+	Material(	const Graphics::Texture2DHandle& diffuse, 
+				const Graphics::Texture2DHandle& normal,
+				const Graphics::Texture2DHandle& height,
+				const Graphics::Texture2DArrayHandle& diffuseArray,
+				const Graphics::Texture2DArrayHandle& normalArray,
+				const Graphics::Texture2DArrayHandle& heightArray,
+				const Graphics::BufferHandle& uniformBuffer)
+				: m_diffuseTextureHandle(diffuse), m_normalMapTextureHandle(normal), m_heightMapTextureHandle(height), 
+				  m_diffuseArrayHandle(diffuseArray), m_normalMapArrayHandle(normalArray), m_heightMapArrayHandle(heightArray), 
+				  m_uniformBuffer(uniformBuffer)
+	{};
+
 	// Default constructor has all handles as invalid; see below
 	Material()
 	{};
@@ -36,23 +84,78 @@ public:
 		return m_normalMapTextureHandle;
 	}
 
+	const Graphics::Texture2DArrayHandle& GetDiffuseTextureArray() const
+	{
+		return m_diffuseArrayHandle;
+	}
+
+	const Graphics::Texture2DArrayHandle& GetHeightMapTextureArray() const
+	{
+		return m_heightMapArrayHandle;
+	}
+
+	const Graphics::Texture2DArrayHandle& GetNormalMapTextureArray() const
+	{
+		return m_normalMapArrayHandle;
+	}
+
 	const Graphics::BufferHandle& GetUniformBuffer() const
 	{
 		return m_uniformBuffer;
 	}
 
+	// Selects the deferred shader-variant, combined with the global features (see DeferredShaderFeature)
+	void SetShaderFeatures(uint32_t features)
+	{
+		m_shaderFeatures = features & DeferredShaderFeature::MaterialFeatures;
+	}
+
+	uint32_t GetShaderFeatures() const
+	{
+		return m_shaderFeatures;
+	}
+
 	// For sorting by material (to reduce state-changes on draw)
 	friend bool operator<(const Material& lhs, const Material& rhs);
 
+	// Orders materials like operator<, for RenderQueue
+	uint64_t GetSortKey() const
+	{
+		// Fits since there are at most 256 texture-arrays (Context::MAX_TEXTURE_ARRAYS)
+		return (static_cast<uint64_t>(m_shaderFeatures) << 40) |
+			(static_cast<uint64_t>(m_diffuseArrayHandle.handle & 0xFF) << 32) |
+			(static_cast<uint64_t>(m_normalMapArrayHandle.handle & 0xFF) << 24) |
+			(static_cast<uint64_t>(m_heightMapArrayHandle.handle & 0xFF) << 16) |
+			m_uniformBuffer.handle;
+	}
+
 private:
 	Graphics::Texture2DHandle m_diffuseTextureHandle   = Graphics::Texture2DHandle::Invalid();
 	Graphics::Texture2DHandle m_normalMapTextureHandle = Graphics::Texture2DHandle::Invalid();
 	Graphics::Texture2DHandle m_heightMapTextureHandle = Graphics::Texture2DHandle::Invalid();
+	Graphics::Texture2DArrayHandle m_diffuseArrayHandle   = Graphics::Texture2DArrayHandle::Invalid();
+	Graphics::Texture2DArrayHandle m_normalMapArrayHandle = Graphics::Texture2DArrayHandle::Invalid();
+	Graphics::Texture2DArrayHandle m_heightMapArrayHandle = Graphics::Texture2DArrayHandle::Invalid();
 	Graphics::BufferHandle    m_uniformBuffer          = Graphics::BufferHandle::Invalid();
+	uint32_t m_shaderFeatures = 0;
 };
 
 inline bool operator<(const Material& lhs, const Material& rhs)
 {
+	// Materials using the same shader-variant together, since changing programs is the most expensive
+	if (lhs.m_shaderFeatures != rhs.m_shaderFeatures)
+		return lhs.m_shaderFeatures < rhs.m_shaderFeatures;
+
+	// Keep materials sharing texture arrays together, so only the UBO changes between them
+	if (lhs.m_diffuseArrayHandle.handle != rhs.m_diffuseArrayHandle.handle)
+		return lhs.m_diffuseArrayHandle.handle < rhs.m_diffuseArrayHandle.handle;
+
+	if (lhs.m_normalMapArrayHandle.handle != rhs.m_normalMapArrayHandle.handle)
+		return lhs.m_normalMapArrayHandle.handle < rhs.m_normalMapArrayHandle.handle;
+
+	if (lhs.m_heightMapArrayHandle.handle != rhs.m_heightMapArrayHandle.handle)
+		return lhs.m_heightMapArrayHandle.handle < rhs.m_heightMapArrayHandle.handle;
+
 	// Same materials have same UBO-handle
 	return lhs.m_uniformBuffer.handle < rhs.m_uniformBuffer.handle;
 }
\ No newline at end of file
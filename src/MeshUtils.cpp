@@ -12,4 +12,27 @@ std::array<float, 84> quadVertices = { {
 	-1.0f, -1.0f, 0.0f,  0.0f, 1.0f,  0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 
 	-1.0f,  1.0f, 0.0f,  0.0f, 0.0f,  0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 
 }};
+
+std::array<float, 112> cubeVertices = { {
+	// Position           //Texcoords  // Normal         // Tangent        // Bitangent
+	// Corner i has x, y, z = +1 for bit 0, 1, 2 set
+	-1.0f, -1.0f, -1.0f,  0.0f, 0.0f,  0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 
+	 1.0f, -1.0f, -1.0f,  0.0f, 0.0f,  0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 
+	-1.0f,  1.0f, -1.0f,  0.0f, 0.0f,  0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 
+	 1.0f,  1.0f, -1.0f,  0.0f, 0.0f,  0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 
+	-1.0f, -1.0f,  1.0f,  0.0f, 0.0f,  0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 
+	 1.0f, -1.0f,  1.0f,  0.0f, 0.0f,  0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 
+	-1.0f,  1.0f,  1.0f,  0.0f, 0.0f,  0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 
+	 1.0f,  1.0f,  1.0f,  0.0f, 0.0f,  0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 
+}};
+
+// Clockwise front-faces (see Context::Init)
+std::array<uint32_t, 36> cubeIndices = { {
+	1, 7, 3, 1, 5, 7, // +X
+	0, 2, 6, 0, 6, 4, // -X
+	2, 3, 7, 2, 7, 6, // +Y
+	0, 5, 1, 0, 4, 5, // -Y
+	4, 7, 5, 4, 6, 7, // +Z
+	0, 1, 3, 0, 3, 2, // -Z
+}};
 }
\ No newline at end of file
@@ -1,8 +1,13 @@
 #pragma once
 
 #include <array>
+#include <stdint.h>
 
 namespace MeshUtils
 {
 	extern std::array<float, 84> quadVertices;
+
+	// [-1, 1]-cube for bounding volumes (only positions are meaningful)
+	extern std::array<float, 112> cubeVertices;
+	extern std::array<uint32_t, 36> cubeIndices;
 }
@@ -0,0 +1,349 @@
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TE_RASTER_SSE 1
+#endif
+
+const int OcclusionCuller::WIDTH;
+const int OcclusionCuller::HEIGHT;
+const size_t OcclusionCuller::VERTEX_CHUNK_SIZE;
+const size_t OcclusionCuller::TRIANGLE_CHUNK_SIZE;
+const int OcclusionCuller::NUM_BANDS;
+const float OcclusionCuller::NEAR_W = 0.05f;
+
+void OcclusionCuller::AddOccluder(const void* positions, uint32_t stride, uint32_t numVertices, const uint32_t* indices, uint32_t numIndices, const glm::mat4& modelMatrix)
+{
+	const uint32_t firstVertex = static_cast<uint32_t>(m_vertices.size());
+
+	for (uint32_t i = 0; i < numVertices; ++i)
+	{
+		const float* p = reinterpret_cast<const float*>(static_cast<const uint8_t*>(positions) + i * stride);
+		const glm::vec4 world = modelMatrix * glm::vec4(p[0], p[1], p[2], 1.0f);
+		m_vertices.push_back(glm::vec3(world.x, world.y, world.z));
+	}
+
+	if (indices)
+	{
+		for (uint32_t i = 0; i + 2 < numIndices; i += 3)
+		{
+			if (indices[i] >= numVertices || indices[i + 1] >= numVertices || indices[i + 2] >= numVertices)
+				continue;
+
+			m_indices.push_back(firstVertex + indices[i]);
+			m_indices.push_back(firstVertex + indices[i + 1]);
+			m_indices.push_back(firstVertex + indices[i + 2]);
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i + 2 < numVertices; i += 3)
+		{
+			m_indices.push_back(firstVertex + i);
+			m_indices.push_back(firstVertex + i + 1);
+			m_indices.push_back(firstVertex + i + 2);
+		}
+	}
+}
+
+void OcclusionCuller::Render(const glm::mat4& viewProj, ThreadPool* threadPool)
+{
+	m_viewProj = viewProj;
+
+	auto run = [threadPool](uint32_t numTasks, const std::function<void(uint32_t)>& task)
+	{
+		if (threadPool)
+			threadPool->Run(numTasks, task);
+		else
+			for (uint32_t i = 0; i < numTasks; ++i)
+				task(i);
+	};
+
+	// Transform to clip-space
+	m_clipVertices.resize(m_vertices.size());
+	const uint32_t numVertexChunks = static_cast<uint32_t>((m_vertices.size() + VERTEX_CHUNK_SIZE - 1) / VERTEX_CHUNK_SIZE);
+
+	run(numVertexChunks, [&](uint32_t chunk)
+	{
+		const size_t end = std::min((chunk + 1) * VERTEX_CHUNK_SIZE, m_vertices.size());
+		for (size_t i = chunk * VERTEX_CHUNK_SIZE; i < end; ++i)
+		{
+			const glm::vec4 clip = viewProj * glm::vec4(m_vertices[i], 1.0f);
+			m_clipVertices[i] = glm::vec3(clip.x, clip.y, clip.w);
+		}
+	});
+
+	// Clip and project the triangles
+	const size_t numTriangles = m_indices.size() / 3;
+	const uint32_t numTriangleChunks = static_cast<uint32_t>((numTriangles + TRIANGLE_CHUNK_SIZE - 1) / TRIANGLE_CHUNK_SIZE);
+	m_chunkTriangles.resize(numTriangleChunks);
+
+	run(numTriangleChunks, [&](uint32_t chunk)
+	{
+		m_chunkTriangles[chunk].clear();
+		SetupTriangles(chunk * TRIANGLE_CHUNK_SIZE, std::min((chunk + 1) * TRIANGLE_CHUNK_SIZE, numTriangles), m_chunkTriangles[chunk]);
+	});
+
+	// Each band of rows is only written by one task
+	if (m_hiZ.empty())
+		m_hiZ.push_back(std::vector<float>(WIDTH * HEIGHT));
+
+	const int rowsPerBand = (HEIGHT + NUM_BANDS - 1) / NUM_BANDS;
+	run(NUM_BANDS, [&](uint32_t band)
+	{
+		RasterizeBand(band * rowsPerBand, std::min<int>((band + 1) * rowsPerBand, HEIGHT));
+	});
+
+	BuildHiZ();
+}
+
+void OcclusionCuller::SetupTriangles(size_t firstTriangle, size_t endTriangle, std::vector<Triangle>& triangles) const
+{
+	for (size_t t = firstTriangle; t < endTriangle; ++t)
+	{
+		const glm::vec3 v[3] = { m_clipVertices[m_indices[t * 3]], m_clipVertices[m_indices[t * 3 + 1]], m_clipVertices[m_indices[t * 3 + 2]] };
+
+		const int numInside = (v[0].z >= NEAR_W) + (v[1].z >= NEAR_W) + (v[2].z >= NEAR_W);
+		if (numInside == 0)
+			continue;
+
+		if (numInside == 3)
+		{
+			AddTriangle(v, triangles);
+			continue;
+		}
+
+		// Clip against the near-plane, giving up to four vertices
+		glm::vec3 polygon[4];
+		int numPolygon = 0;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			const glm::vec3& a = v[i];
+			const glm::vec3& b = v[(i + 1) % 3];
+
+			if (a.z >= NEAR_W)
+				polygon[numPolygon++] = a;
+
+			if ((a.z >= NEAR_W) != (b.z >= NEAR_W))
+			{
+				const float s = (NEAR_W - a.z) / (b.z - a.z);
+				polygon[numPolygon++] = a + (b - a) * s;
+			}
+		}
+
+		for (int i = 1; i + 1 < numPolygon; ++i)
+		{
+			const glm::vec3 fan[3] = { polygon[0], polygon[i], polygon[i + 1] };
+			AddTriangle(fan, triangles);
+		}
+	}
+}
+
+void OcclusionCuller::AddTriangle(const glm::vec3 clip[3], std::vector<Triangle>& triangles) const
+{
+	Triangle tri;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		const float invW = 1.0f / clip[i].z;
+		tri.x[i] = (clip[i].x * invW * 0.5f + 0.5f) * WIDTH;
+		tri.y[i] = (clip[i].y * invW * 0.5f + 0.5f) * HEIGHT;
+		tri.z[i] = invW;
+	}
+
+	// Both sides are drawn, so flip clockwise triangles
+	const float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.y[1] - tri.y[0]) * (tri.x[2] - tri.x[0]);
+	if (std::fabs(area) < 1e-6f)
+		return;
+
+	if (area < 0.0f)
+	{
+		std::swap(tri.x[1], tri.x[2]);
+		std::swap(tri.y[1], tri.y[2]);
+		std::swap(tri.z[1], tri.z[2]);
+	}
+
+	// Pixels whose centers may be covered
+	tri.minX = std::max(static_cast<int>(std::floor(std::min(std::min(tri.x[0], tri.x[1]), tri.x[2]))), 0);
+	tri.maxX = std::min(static_cast<int>(std::floor(std::max(std::max(tri.x[0], tri.x[1]), tri.x[2]))), WIDTH - 1);
+	tri.minY = std::max(static_cast<int>(std::floor(std::min(std::min(tri.y[0], tri.y[1]), tri.y[2]))), 0);
+	tri.maxY = std::min(static_cast<int>(std::floor(std::max(std::max(tri.y[0], tri.y[1]), tri.y[2]))), HEIGHT - 1);
+
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+		return;
+
+	triangles.push_back(tri);
+}
+
+void OcclusionCuller::RasterizeBand(int firstRow, int endRow)
+{
+	float* depth = m_hiZ[0].data();
+	std::fill(depth + firstRow * WIDTH, depth + endRow * WIDTH, 0.0f);
+
+	for (const auto& triangles : m_chunkTriangles)
+	{
+		for (const Triangle& tri : triangles)
+		{
+			const int minY = std::max(tri.minY, firstRow);
+			const int maxY = std::min(tri.maxY, endRow - 1);
+			if (minY > maxY)
+				continue;
+
+			// Edge-functions (v[i] -> v[i+1]) are 'a * x + b * y + c', positive inside
+			float a[3], b[3], c[3];
+			for (int i = 0; i < 3; ++i)
+			{
+				const int j = (i + 1) % 3;
+				a[i] = tri.y[i] - tri.y[j];
+				b[i] = tri.x[j] - tri.x[i];
+				c[i] = -(a[i] * tri.x[i] + b[i] * tri.y[i]);
+			}
+
+			// Depth is linear in screen-space
+			const float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.y[1] - tri.y[0]) * (tri.x[2] - tri.x[0]);
+			const float dzdx = ((tri.z[1] - tri.z[0]) * (tri.y[2] - tri.y[0]) - (tri.z[2] - tri.z[0]) * (tri.y[1] - tri.y[0])) / area;
+			const float dzdy = ((tri.z[2] - tri.z[0]) * (tri.x[1] - tri.x[0]) - (tri.z[1] - tri.z[0]) * (tri.x[2] - tri.x[0])) / area;
+			const float z0 = tri.z[0] - dzdx * tri.x[0] - dzdy * tri.y[0];
+
+			const int minX = tri.minX & ~3;
+
+			for (int y = minY; y <= maxY; ++y)
+			{
+				const float py = y + 0.5f;
+				float* row = depth + y * WIDTH;
+
+#if TE_RASTER_SSE
+				const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+				const __m128 zero = _mm_setzero_ps();
+
+				__m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(minX)), offsets);
+				const __m128 step = _mm_set1_ps(4.0f);
+
+				const __m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]);
+				const __m128 row0 = _mm_set1_ps(b[0] * py + c[0]), row1 = _mm_set1_ps(b[1] * py + c[1]), row2 = _mm_set1_ps(b[2] * py + c[2]);
+				const __m128 zdx = _mm_set1_ps(dzdx), zrow = _mm_set1_ps(z0 + dzdy * py);
+
+				for (int x = minX; x <= tri.maxX; x += 4)
+				{
+					const __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+					const __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+					const __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+					const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+
+					if (_mm_movemask_ps(inside))
+					{
+						const __m128 old = _mm_loadu_ps(row + x);
+						const __m128 z = _mm_max_ps(old, _mm_add_ps(_mm_mul_ps(zdx, px), zrow));
+						_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, z), _mm_andnot_ps(inside, old)));
+					}
+
+					px = _mm_add_ps(px, step);
+				}
+#else
+				for (int x = minX; x <= tri.maxX; ++x)
+				{
+					const float px = x + 0.5f;
+					if (a[0] * px + b[0] * py + c[0] >= 0.0f && a[1] * px + b[1] * py + c[1] >= 0.0f && a[2] * px + b[2] * py + c[2] >= 0.0f)
+						row[x] = std::max(row[x], z0 + dzdx * px + dzdy * py);
+				}
+#endif
+			}
+		}
+	}
+}
+
+void OcclusionCuller::BuildHiZ()
+{
+	int width = WIDTH, height = HEIGHT;
+
+	for (size_t level = 1; width >= 2 && height >= 2; ++level)
+	{
+		const int srcWidth = width;
+		width /= 2;
+		height /= 2;
+
+		if (m_hiZ.size() <= level)
+			m_hiZ.push_back(std::vector<float>(width * height));
+
+		const std::vector<float>& src = m_hiZ[level - 1];
+		std::vector<float>& dst = m_hiZ[level];
+
+		for (int y = 0; y < height; ++y)
+		{
+			const float* row0 = &src[(y * 2) * srcWidth];
+			const float* row1 = row0 + srcWidth;
+
+			for (int x = 0; x < width; ++x)
+				dst[y * width + x] = std::min(std::min(row0[x * 2], row0[x * 2 + 1]), std::min(row1[x * 2], row1[x * 2 + 1]));
+		}
+	}
+}
+
+bool OcclusionCuller::IsOccluded(const glm::vec3& center, float radius) const
+{
+	if (m_hiZ.empty())
+		return false;
+
+	const glm::mat4& m = m_viewProj;
+
+	// The nearest point of the sphere
+	const glm::vec3 wRow(m[0][3], m[1][3], m[2][3]);
+	const float nearestW = glm::dot(wRow, center) + m[3][3] - radius * glm::length(wRow);
+	if (nearestW < NEAR_W)
+		return false;
+
+	// Screen-space bounds of the enclosing box
+	const glm::vec4 base = m * glm::vec4(center, 1.0f);
+	const glm::vec4 dx = m[0] * radius, dy = m[1] * radius, dz = m[2] * radius;
+
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	for (int i = 0; i < 8; ++i)
+	{
+		const glm::vec4 corner = base + dx * ((i & 1) ? 1.0f : -1.0f) + dy * ((i & 2) ? 1.0f : -1.0f) + dz * ((i & 4) ? 1.0f : -1.0f);
+		if (corner.w < NEAR_W)
+			return false;
+
+		const float x = (corner.x / corner.w * 0.5f + 0.5f) * WIDTH;
+		const float y = (corner.y / corner.w * 0.5f + 0.5f) * HEIGHT;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+	}
+
+	const int x0 = std::max(static_cast<int>(std::floor(minX)), 0);
+	const int x1 = std::min(static_cast<int>(std::floor(maxX)), WIDTH - 1);
+	const int y0 = std::max(static_cast<int>(std::floor(minY)), 0);
+	const int y1 = std::min(static_cast<int>(std::floor(maxY)), HEIGHT - 1);
+	if (x0 > x1 || y0 > y1)
+		return false;
+
+	// A level where the bounds cover at most 3x3 texels
+	size_t level = 0;
+	const int size = std::max(x1 - x0, y1 - y0) + 1;
+	while ((size >> level) > 2 && level + 1 < m_hiZ.size())
+		++level;
+
+	const int levelWidth = WIDTH >> level;
+	const std::vector<float>& hiZ = m_hiZ[level];
+	const float nearestZ = 1.0f / nearestW;
+
+	// Occluded if the farthest occluder-depth everywhere is in front
+	for (int y = y0 >> level; y <= (y1 >> level); ++y)
+	{
+		for (int x = x0 >> level; x <= (x1 >> level); ++x)
+		{
+			if (hiZ[y * levelWidth + x] <= nearestZ)
+				return false;
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
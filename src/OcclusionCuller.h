@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "glm/glm.hpp"
+
+#include "FrustumCuller.h"
+
+class ThreadPool;
+
+// Software occlusion-culling: occluder meshes are rasterized into a small depth-buffer on the CPU, and
+// bounding spheres completely behind them are removed from the visible list before anything is drawn.
+// Depth is stored as 1/w (larger is nearer), so it doesn't depend on the projection's depth-range.
+class OcclusionCuller
+{
+public:
+	static const int WIDTH = 256; // A multiple of 4
+	static const int HEIGHT = 128;
+
+	// Adds world-space triangles. 'positions' points to the first of 'numVertices' vec3s 'stride' bytes
+	// apart; without indices every three vertices make a triangle.
+	void AddOccluder(const void* positions, uint32_t stride, uint32_t numVertices, const uint32_t* indices, uint32_t numIndices, const glm::mat4& modelMatrix);
+
+	size_t GetNumOccluderTriangles() const
+	{
+		return m_indices.size() / 3;
+	}
+
+	// Rasterizes the occluders, split into bands of rows culled by the thread-pool's threads if given
+	void Render(const glm::mat4& viewProj, ThreadPool* threadPool = nullptr);
+
+	// Tests a sphere against what was last rendered
+	bool IsOccluded(const glm::vec3& center, float radius) const;
+
+	// Removes occluded entries from 'visible', using the spheres they were frustum-culled with,
+	// keeping the order. Returns how many were removed.
+	uint32_t Cull(FrustumCuller::VisibleList& visible, const FrustumCuller& frustumCuller) const
+	{
+		const bool hasDepths = visible.depths.size() >= visible.count;
+
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < visible.count; ++i)
+		{
+			const glm::vec4 sphere = frustumCuller.GetSphere(visible.indices[i]);
+
+			visible.indices[count] = visible.indices[i];
+			if (hasDepths)
+				visible.depths[count] = visible.depths[i];
+
+			count += !IsOccluded(glm::vec3(sphere.x, sphere.y, sphere.z), sphere.w);
+		}
+
+		const uint32_t removed = visible.count - count;
+		visible.count = count;
+		return removed;
+	}
+
+private:
+	// Screen-space, with positive area
+	struct Triangle
+	{
+		float x[3];
+		float y[3];
+		float z[3];
+		int minX, maxX;
+		int minY, maxY;
+	};
+
+	void SetupTriangles(size_t firstTriangle, size_t endTriangle, std::vector<Triangle>& triangles) const;
+	void AddTriangle(const glm::vec3 clip[3], std::vector<Triangle>& triangles) const;
+	void RasterizeBand(int firstRow, int endRow);
+	void BuildHiZ();
+
+	// Vertices closer than this (in clip-space w) are clipped
+	static const float NEAR_W;
+
+	static const size_t VERTEX_CHUNK_SIZE = 4096;
+	static const size_t TRIANGLE_CHUNK_SIZE = 2048;
+	static const int NUM_BANDS = 16;
+
+	std::vector<glm::vec3> m_vertices;
+	std::vector<uint32_t> m_indices;
+
+	// Per frame
+	glm::mat4 m_viewProj;
+	std::vector<glm::vec3> m_clipVertices; // x, y, w
+	std::vector<std::vector<Triangle>> m_chunkTriangles;
+
+	// Level 0 is the nearest depth per pixel; each following level the farthest of four texels in the last
+	std::vector<std::vector<float>> m_hiZ;
+};
\ No newline at end of file
@@ -7,7 +7,7 @@ bool PostProcess_SSAO::Init(Graphics::RenderingSystem& ri, Graphics::BufferHandl
 	m_fullscreenquadBuffer = fullscreenQuad;
 
 	m_ssaoProgram = m_renderingSystem->CreateShaderProgram(
-		Graphics::ShaderInfo::VSFS("Shaders/SSAO.vs", "Shaders/SSAO.fs", "Shaders/")
+		Graphics::ShaderInfo::VSFS("shaders/SSAO.vs", "shaders/SSAO.fs", "shaders/")
 	);
 
 	return true;
@@ -0,0 +1,141 @@
+#include "RenderQueue.h"
+
+#include <cassert>
+#include <algorithm>
+
+const uint32_t RenderQueue::NONE;
+
+namespace
+{
+	struct EntryKeyLess
+	{
+		template<typename T>
+		bool operator()(const T& a, const T& b) const
+		{
+			return a.key < b.key;
+		}
+	};
+}
+
+void RenderQueue::Insert(uint32_t item, uint64_t key)
+{
+	assert(!Contains(item));
+
+	if (item >= m_positions.size())
+		m_positions.resize(item + 1, NONE);
+
+	m_positions[item] = static_cast<uint32_t>(m_entries.size());
+
+	Entry entry;
+	entry.key = key;
+	entry.item = item;
+	m_entries.push_back(entry);
+}
+
+void RenderQueue::Remove(uint32_t item)
+{
+	assert(Contains(item));
+
+	// Left in place (still ordered by its key) until the next Sort()
+	m_entries[m_positions[item]].item = NONE;
+	m_positions[item] = NONE;
+	++m_numRemoved;
+}
+
+void RenderQueue::Update(uint32_t item, uint64_t key)
+{
+	assert(Contains(item));
+
+	const uint32_t position = m_positions[item];
+	const bool unsorted = position >= m_numSorted;
+	const bool afterPrevious = position == 0 || m_entries[position - 1].key <= key;
+	const bool beforeNext = position + 1 >= m_numSorted || key <= m_entries[position + 1].key;
+
+	if (unsorted || (afterPrevious && beforeNext))
+	{
+		m_entries[position].key = key;
+	}
+	else
+	{
+		Remove(item);
+		Insert(item, key);
+	}
+}
+
+void RenderQueue::Sort()
+{
+	if (m_numSorted == m_entries.size() && m_numRemoved == 0)
+		return;
+
+	// Entries before the first change keep their positions
+	size_t firstChanged = m_numSorted;
+
+	if (m_numRemoved > 0)
+	{
+		const auto isRemoved = [](const Entry& entry) { return entry.item == NONE; };
+		const auto firstRemoved = std::find_if(m_entries.begin(), m_entries.end(), isRemoved);
+		const size_t numSortedKept = m_numSorted - std::count_if(m_entries.begin(), m_entries.begin() + m_numSorted, isRemoved);
+
+		firstChanged = std::min(firstChanged, static_cast<size_t>(firstRemoved - m_entries.begin()));
+		m_entries.erase(std::remove_if(firstRemoved, m_entries.end(), isRemoved), m_entries.end());
+		m_numSorted = numSortedKept;
+		m_numRemoved = 0;
+	}
+
+	// Only the new entries are sorted, then merged with the rest
+	const auto middle = m_entries.begin() + m_numSorted;
+	std::sort(middle, m_entries.end(), EntryKeyLess());
+
+	if (middle != m_entries.end())
+	{
+		const size_t firstInserted = std::upper_bound(m_entries.begin(), middle, *middle, EntryKeyLess()) - m_entries.begin();
+		firstChanged = std::min(firstChanged, firstInserted);
+		std::inplace_merge(m_entries.begin() + firstInserted, middle, m_entries.end(), EntryKeyLess());
+	}
+
+	m_numSorted = m_entries.size();
+
+	for (size_t i = firstChanged; i < m_entries.size(); ++i)
+		m_positions[m_entries[i].item] = static_cast<uint32_t>(i);
+}
+
+void RenderQueue::Order(uint32_t* items, uint32_t count)
+{
+	Sort();
+
+	// Sorting costs about count * log2(count) comparisons, walking the whole queue one step per entry
+	uint32_t log2Count = 0;
+	while ((1u << log2Count) < count)
+		++log2Count;
+
+	if (static_cast<uint64_t>(count) * log2Count < m_entries.size())
+	{
+		std::sort(items, items + count, [this](uint32_t a, uint32_t b)
+		{
+			return m_positions[a] < m_positions[b];
+		});
+
+		return;
+	}
+
+	if (m_marked.size() < m_positions.size())
+		m_marked.resize(m_positions.size(), 0);
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		assert(Contains(items[i]));
+		m_marked[items[i]] = 1;
+	}
+
+	uint32_t numOrdered = 0;
+	for (const Entry& entry : m_entries)
+	{
+		if (m_marked[entry.item])
+		{
+			items[numOrdered++] = entry.item;
+			m_marked[entry.item] = 0;
+		}
+	}
+
+	assert(numOrdered == count);
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Items (e.g. indices of renderables) kept in ascending order of a sort-key, such as Material::GetSortKey().
+// Changes are cheap and collected until Sort(), which only sorts what was inserted since last time and merges
+// it in, so a queue that hasn't changed costs nothing to keep ordered.
+class RenderQueue
+{
+public:
+	// An item can only be in the queue once
+	void Insert(uint32_t item, uint64_t key);
+	void Remove(uint32_t item);
+
+	// Stays in place if the new key is still in order with its neighbours
+	void Update(uint32_t item, uint64_t key);
+
+	bool Contains(uint32_t item) const
+	{
+		return item < m_positions.size() && m_positions[item] != NONE;
+	}
+
+	size_t GetNumItems() const
+	{
+		return m_entries.size() - m_numRemoved;
+	}
+
+	// Applies the changes made since the last call
+	void Sort();
+
+	// Reorders 'count' items that are in the queue (e.g. what was left after culling) into queue-order,
+	// by walking the queue or sorting by position, whichever is less work.
+	void Order(uint32_t* items, uint32_t count);
+
+private:
+	struct Entry
+	{
+		uint64_t key;
+		uint32_t item; // NONE once removed
+	};
+
+	static const uint32_t NONE = ~0u;
+
+	// The first m_numSorted are in order, followed by what's been inserted since the last Sort()
+	std::vector<Entry> m_entries;
+	size_t m_numSorted = 0;
+	size_t m_numRemoved = 0;
+
+	// By item: the index of its entry, or NONE
+	std::vector<uint32_t> m_positions;
+
+	// By item, for Order()
+	std::vector<uint8_t> m_marked;
+};
\ No newline at end of file
@@ -1,9 +1,6 @@
 #pragma once
 
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-#include <glm/gtx/quaternion.hpp>
+#include <cstdint>
 
 #include "UBOsAndMesh.h"
 #include "Material.h"
@@ -16,55 +13,56 @@ public:
 	// and material aren't deleted before the renderable. 
 	// (Could use handles with generation/counter number to detect this.)
 
-	Renderable(const Mesh& mesh, const Material& material)
-		: m_position(glm::vec3(0, 0, 0)), m_scale(1.0f), m_material(material), m_mesh(mesh)
+	// The transform is an index into the TransformStore the renderable is placed with
+	Renderable(const Mesh& mesh, const Material& material, uint32_t transform)
+		: m_material(material), m_mesh(mesh), m_transform(transform), m_occlusionQuery(Graphics::QueryHandle::Invalid())
 	{
 
 	}
 
-	void SetPosition(const glm::vec3& position)
+	uint32_t GetTransform() const
 	{
-		m_position = position;
+		return m_transform;
 	}
 
-	const glm::vec3& GetPosition() const
-	{
-		return m_position;
-	}
-
-	void SetScale(float scale)
+	const Material& GetMaterial() const
 	{
-		m_scale = scale; // Only uniform scaling
+		return m_material;
 	}
 
-	float GetScale() const
+	const Mesh& GetMesh() const
 	{
-		return m_scale;
+		return m_mesh;
 	}
 
-	float GetRadius() const
+	// Invalid unless the renderable is drawn conditionally on the previous frame's occlusion query
+	void SetOcclusionQuery(Graphics::QueryHandle query)
 	{
-		return m_mesh.radius * m_scale;
+		m_occlusionQuery = query;
 	}
 
-	glm::mat4 GetModelMatrix() const
+	Graphics::QueryHandle GetOcclusionQuery() const
 	{
-		return glm::translate(glm::mat4(), GetPosition()) * glm::scale(glm::mat4(), glm::vec3(m_scale));
+		return m_occlusionQuery;
 	}
 
-	const Material& GetMaterial() const
+	// The frame the occlusion query was last issued in; its result is only used the frame after
+	void SetOcclusionQueryFrame(uint32_t frame)
 	{
-		return m_material;
+		m_occlusionQueryFrame = frame;
+		m_hasOcclusionQueryFrame = true;
 	}
 
-	const Mesh& GetMesh() const
+	bool WasOcclusionQueryIssued(uint32_t frame) const
 	{
-		return m_mesh;
+		return m_hasOcclusionQueryFrame && m_occlusionQueryFrame == frame;
 	}
 
 private:
-	glm::vec3 m_position;
-	float     m_scale;
 	Material  m_material;
 	Mesh      m_mesh;
+	uint32_t  m_transform;
+	Graphics::QueryHandle m_occlusionQuery;
+	uint32_t  m_occlusionQueryFrame = 0;
+	bool      m_hasOcclusionQueryFrame = false;
 };
\ No newline at end of file
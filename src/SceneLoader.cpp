@@ -202,6 +202,10 @@ void luaParseMeshes(LuaState& L, SceneLoader::SceneInfo& outSceneInfo)
 		mesh.indexDataSize = GetInt(L.get(), "indices_size");
 		mesh.indexDataOffset = GetInt(L.get(), "indices_offset");		
 
+		lua_getfield(L.get(), -1, "occluder");
+		mesh.occluder = lua_isnil(L.get(), -1) ? -1 : lua_toboolean(L.get(), -1);
+		lua_pop(L.get(), 1);
+
 		outSceneInfo.meshes.push_back(mesh);
 
 		lua_pop(L.get(), 1); // Stack: table, mesh-table
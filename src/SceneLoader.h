@@ -22,6 +22,8 @@ namespace SceneLoader
 		uint32_t numIndices;
 		uint32_t indexDataSize;
 		uint32_t indexDataOffset;
+
+		int occluder; // 1 or 0 if given by the scene ('occluder=true/false'), otherwise -1
 	};
 
 	struct MaterialInfo
@@ -0,0 +1,30 @@
+#include "ShaderVariants.h"
+
+#include <cassert>
+
+void ShaderVariants::Init(const Graphics::ShaderInfo& shaderInfo, const std::vector<std::string>& features)
+{
+	assert(features.size() <= 32);
+
+	m_shaderInfo = shaderInfo;
+	m_features = features;
+	m_variants.clear();
+}
+
+Graphics::ShaderProgramHandle ShaderVariants::Get(Graphics::RenderingSystem& rs, uint32_t mask)
+{
+	const auto& f = m_variants.find(mask);
+	if (f != m_variants.end())
+		return f->second;
+
+	Graphics::ShaderInfo variant = m_shaderInfo;
+	for (size_t i = 0; i < m_features.size(); ++i)
+	{
+		if (mask & (1u << i))
+			variant.addDefine(m_features[i]);
+	}
+
+	Graphics::ShaderProgramHandle handle = rs.CreateShaderProgram(variant);
+	m_variants.emplace(mask, handle);
+	return handle;
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "graphics/RenderingSystem.h"
+
+// Compile-time specializations of one shader-program. Each feature is a '#define', and a variant is
+// selected by a mask of feature-indices (bit i enables features[i]). Variants are created on first 
+// request and cached.
+class ShaderVariants
+{
+public:
+	void Init(const Graphics::ShaderInfo& shaderInfo, const std::vector<std::string>& features);
+
+	Graphics::ShaderProgramHandle Get(Graphics::RenderingSystem& rs, uint32_t mask);
+
+	size_t GetNumVariants() const
+	{
+		return m_variants.size();
+	}
+
+private:
+	Graphics::ShaderInfo m_shaderInfo;
+	std::vector<std::string> m_features;
+	std::unordered_map<uint32_t, Graphics::ShaderProgramHandle> m_variants;
+};
\ No newline at end of file
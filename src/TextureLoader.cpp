@@ -5,28 +5,161 @@
 #define STBI_HEADER_FILE_ONLY
 #include "stb_image.c"
 
+TextureLoader::~TextureLoader()
+{
+	m_shouldExit = true;
+
+	if (m_thread.joinable())
+		m_thread.join();
+
+	for (auto& loaded : m_loaded)
+	{
+		if (loaded.data)
+			stbi_image_free(loaded.data);
+	}
+}
+
+void TextureLoader::LoaderThread(std::string dataPrefix)
+{
+	while (!m_shouldExit)
+	{
+		TextureToLoad tex;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_toLoadVector.empty())
+				break;
+
+			tex = m_toLoadVector.back();
+			m_toLoadVector.pop_back();
+		}
+
+		LoadedTexture loaded;
+		loaded.toLoad = tex;
+		loaded.fullPath = dataPrefix + tex.imageFile;
+
+		int comp;
+		loaded.data = stbi_load(loaded.fullPath.c_str(), &loaded.width, &loaded.height, &comp, 4);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_loaded.push_back(loaded);
+	}
+
+	m_threadRunning = false;
+}
+
+bool TextureLoader::MayHaveAlpha(const std::string& imagePath)
+{
+	int x, y, comp;
+	if (!stbi_info(imagePath.c_str(), &x, &y, &comp))
+		return true;
+
+	// Grey-alpha or RGBA
+	return comp == 2 || comp == 4;
+}
+
+bool TextureLoader::ScheduleArrayLayer(Graphics::RenderingSystem& rs, const std::string& dataPrefix, const std::string& imageFile, Graphics::TextureType type, ArrayLayer& outLayer)
+{
+	int x, y, comp;
+	if (!stbi_info((dataPrefix + imageFile).c_str(), &x, &y, &comp))
+		return false;
+
+	const uint16_t width = static_cast<uint16_t>(x);
+	const uint16_t height = static_cast<uint16_t>(y);
+
+	TextureArray* textureArray = nullptr;
+
+	for (auto& candidate : m_textureArrays)
+	{
+		if (!candidate.allocated && candidate.layers < MAX_ARRAY_LAYERS && 
+			candidate.width == width && candidate.height == height && candidate.type == type)
+		{
+			textureArray = &candidate;
+			break;
+		}
+	}
+
+	if (!textureArray)
+	{
+		m_textureArrays.push_back({ rs.CreateTexture2DArray(), width, height, 0, type, false });
+		textureArray = &m_textureArrays.back();
+	}
+
+	outLayer.handle = textureArray->handle;
+	outLayer.layer = textureArray->layers++;
+
+	TextureToLoad toLoad;
+	toLoad.handle = Graphics::Texture2DHandle::Invalid();
+	toLoad.imageFile = imageFile;
+	toLoad.type = type;
+	toLoad.arrayHandle = outLayer.handle;
+	toLoad.layer = outLayer.layer;
+	Schedule(toLoad);
+
+	return true;
+}
+
+void TextureLoader::AllocateTextureArrays(Graphics::RenderingSystem& rs)
+{
+	for (auto& textureArray : m_textureArrays)
+	{
+		if (!textureArray.allocated)
+		{
+			rs.AllocateTexture2DArray(textureArray.handle, textureArray.width, textureArray.height, textureArray.layers, textureArray.type);
+			textureArray.allocated = true;
+		}
+	}
+}
+
 void TextureLoader::LoadOne(Graphics::RenderingSystem& rs, const std::string& dataPrefix)
 {
-	if (!m_toLoadVector.empty())
+	// Must precede uploads to the arrays
+	AllocateTextureArrays(rs);
+
+	// (Re)start the loader-thread if there's something to decode
+	if (!m_threadRunning)
 	{
-		auto tex = m_toLoadVector.back();
-		m_toLoadVector.pop_back();
+		if (m_thread.joinable())
+			m_thread.join();
 
-		std::string fullPath = dataPrefix + tex.imageFile;
-		Graphics::TextureType type = tex.type;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_toLoadVector.empty())
+		{
+			m_threadRunning = true;
+			m_thread = std::thread(&TextureLoader::LoaderThread, this, dataPrefix);
+		}
+	}
 
-		int x, y, comp;
-		uint8_t* textureData = stbi_load(fullPath.c_str(), &x, &y, &comp, 4);
+	LoadedTexture loaded;
 
-		if (textureData)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_loaded.empty())
+			return;
+
+		loaded = m_loaded.front();
+		m_loaded.pop_front();
+	}
+
+	if (loaded.data)
+	{
+		const TextureToLoad& tex = loaded.toLoad;
+
+		if (!tex.arrayHandle.IsValid())
 		{
-			printf("Loaded %s\n", fullPath.c_str());
-			rs.UpdateTexture2D(tex.handle, textureData, x, y, type);
-			stbi_image_free(textureData);
+			printf("Loaded %s\n", loaded.fullPath.c_str());
+			rs.UpdateTexture2D(tex.handle, loaded.data, loaded.width, loaded.height, tex.type);
 		}
 		else
 		{
-			printf("Failed to load %s\n", fullPath.c_str());
+			printf("Loaded %s (array %d, layer %d)\n", loaded.fullPath.c_str(), tex.arrayHandle.handle, tex.layer);
+			rs.UpdateTexture2DArrayLayer(tex.arrayHandle, tex.layer, loaded.data, loaded.width, loaded.height);
 		}
+
+		stbi_image_free(loaded.data);
+	}
+	else
+	{
+		printf("Failed to load %s\n", loaded.fullPath.c_str());
 	}
 }
\ No newline at end of file
@@ -2,6 +2,10 @@
 
 #include <string>
 #include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 #include "graphics/ForwardDecl.h"
 #include "graphics/Handles.h"
@@ -15,15 +19,68 @@ public:
 		Graphics::Texture2DHandle handle;
 		std::string imageFile;
 		Graphics::TextureType type;
+
+		// Set instead of handle when loading into a texture array (see ScheduleArrayLayer)
+		Graphics::Texture2DArrayHandle arrayHandle;
+		uint16_t layer;
+	};
+
+	struct ArrayLayer
+	{
+		Graphics::Texture2DArrayHandle handle;
+		uint16_t layer;
 	};
 
+	~TextureLoader();
+
 	void Schedule(const TextureToLoad& toLoad)
 	{
+		std::lock_guard<std::mutex> lock(m_mutex);
 		m_toLoadVector.push_back(toLoad);
 	}
 
+	// Places the texture in a layer of a texture array shared with other textures of the same size and type.
+	// The image's size is read from its header; returns false if that fails.
+	bool ScheduleArrayLayer(Graphics::RenderingSystem& rs, const std::string& dataPrefix, const std::string& imageFile, Graphics::TextureType type, ArrayLayer& outLayer);
+
+	// Whether the image has an alpha-channel, read from its header; true if that fails, as it might
+	static bool MayHaveAlpha(const std::string& imagePath);
+
+	// Image-decoding is done on a loader-thread (started by the first call);
+	// each call hands at most one decoded texture to the renderingsystem.
 	void LoadOne(Graphics::RenderingSystem& rs, const std::string& dataPrefix);
 
 private:
+	struct LoadedTexture
+	{
+		TextureToLoad toLoad;
+		std::string fullPath;
+		uint8_t* data;
+		int width;
+		int height;
+	};
+
+	void LoaderThread(std::string dataPrefix);
+	void AllocateTextureArrays(Graphics::RenderingSystem& rs);
+
+	// Storage is allocated for all arrays on the next LoadOne(); after that they can't grow
+	struct TextureArray
+	{
+		Graphics::Texture2DArrayHandle handle;
+		uint16_t width;
+		uint16_t height;
+		uint16_t layers;
+		Graphics::TextureType type;
+		bool allocated;
+	};
+	static const uint16_t MAX_ARRAY_LAYERS = 256;
+	std::vector<TextureArray> m_textureArrays;
+
 	std::vector<TextureToLoad> m_toLoadVector;
+	std::deque<LoadedTexture> m_loaded;
+	std::mutex m_mutex;
+
+	std::thread m_thread;
+	std::atomic<bool> m_threadRunning{ false };
+	std::atomic<bool> m_shouldExit{ false };
 };
\ No newline at end of file
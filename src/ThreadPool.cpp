@@ -0,0 +1,101 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned numWorkers)
+{
+	for (unsigned i = 0; i < numWorkers; ++i)
+		m_workers.push_back(std::thread(&ThreadPool::WorkerThread, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shouldExit = true;
+	}
+	m_start.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+unsigned ThreadPool::DefaultNumWorkers()
+{
+	// May return 0 if unknown
+	return std::max(std::thread::hardware_concurrency(), 1u) - 1;
+}
+
+void ThreadPool::Run(uint32_t numTasks, const std::function<void(uint32_t)>& task)
+{
+	if (numTasks == 0)
+		return;
+
+	if (m_workers.empty() || numTasks == 1)
+	{
+		for (uint32_t i = 0; i < numTasks; ++i)
+			task(i);
+		return;
+	}
+
+	{
+		// Workers late to wake up for the previous run may still be leaving it
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this] { return m_activeWorkers == 0; });
+
+		m_task = &task;
+		m_numTasks = numTasks;
+		m_nextTask = 0;
+		m_tasksDone = 0;
+		++m_generation;
+	}
+	m_start.notify_all();
+
+	RunTasks();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return m_tasksDone == m_numTasks; });
+	m_task = nullptr;
+}
+
+void ThreadPool::RunTasks()
+{
+	uint32_t i;
+	while ((i = m_nextTask++) < m_numTasks)
+	{
+		(*m_task)(i);
+
+		if (++m_tasksDone == m_numTasks)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_done.notify_all();
+		}
+	}
+}
+
+void ThreadPool::WorkerThread()
+{
+	uint32_t generation = 0;
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_start.wait(lock, [&] { return m_shouldExit || m_generation != generation; });
+
+			if (m_shouldExit)
+				return;
+
+			generation = m_generation;
+			++m_activeWorkers;
+		}
+
+		RunTasks();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_activeWorkers;
+		}
+		m_done.notify_all();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+// Worker-threads for splitting up work on the main thread. The calling thread takes part in the work,
+// so a pool without workers just runs everything in Run(). Run() isn't reentrant, and must only be
+// called from one thread at a time.
+class ThreadPool
+{
+public:
+	// Defaults to one worker less than the number of hardware threads
+	explicit ThreadPool(unsigned numWorkers = DefaultNumWorkers());
+	~ThreadPool();
+
+	// Calls 'task(i)' for all i in [0, numTasks) in no particular order, and returns once all are done
+	void Run(uint32_t numTasks, const std::function<void(uint32_t)>& task);
+
+	// Including the calling thread
+	unsigned GetNumThreads() const
+	{
+		return static_cast<unsigned>(m_workers.size()) + 1;
+	}
+
+	static unsigned DefaultNumWorkers();
+
+private:
+	void WorkerThread();
+	void RunTasks();
+
+	std::vector<std::thread> m_workers;
+
+	// Only changed while no worker is in RunTasks()
+	const std::function<void(uint32_t)>* m_task = nullptr;
+	uint32_t m_numTasks = 0;
+	uint32_t m_generation = 0;
+	unsigned m_activeWorkers = 0;
+	bool m_shouldExit = false;
+
+	std::atomic<uint32_t> m_nextTask{ 0 };
+	std::atomic<uint32_t> m_tasksDone{ 0 };
+
+	std::mutex m_mutex;
+	std::condition_variable m_start;
+	std::condition_variable m_done;
+};
\ No newline at end of file
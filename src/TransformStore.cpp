@@ -0,0 +1,148 @@
+#include "TransformStore.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TE_TRANSFORM_SSE 1
+#endif
+
+uint32_t TransformStore::Add(const glm::vec3& position, const glm::quat& rotation, float scale)
+{
+	const uint32_t index = static_cast<uint32_t>(m_scale.size());
+
+	m_x.push_back(position.x);
+	m_y.push_back(position.y);
+	m_z.push_back(position.z);
+	m_rotationX.push_back(rotation.x);
+	m_rotationY.push_back(rotation.y);
+	m_rotationZ.push_back(rotation.z);
+	m_rotationW.push_back(rotation.w);
+	m_scale.push_back(scale);
+	m_worldMatrices.push_back(glm::mat4(1.0f));
+	m_isDirty.push_back(0);
+
+	MarkDirty(index);
+	return index;
+}
+
+void TransformStore::SetPosition(uint32_t index, const glm::vec3& position)
+{
+	m_x[index] = position.x;
+	m_y[index] = position.y;
+	m_z[index] = position.z;
+	MarkDirty(index);
+}
+
+void TransformStore::SetRotation(uint32_t index, const glm::quat& rotation)
+{
+	m_rotationX[index] = rotation.x;
+	m_rotationY[index] = rotation.y;
+	m_rotationZ[index] = rotation.z;
+	m_rotationW[index] = rotation.w;
+	MarkDirty(index);
+}
+
+void TransformStore::SetScale(uint32_t index, float scale)
+{
+	m_scale[index] = scale;
+	MarkDirty(index);
+}
+
+glm::quat TransformStore::GetRotation(uint32_t index) const
+{
+	glm::quat rotation;
+	rotation.x = m_rotationX[index];
+	rotation.y = m_rotationY[index];
+	rotation.z = m_rotationZ[index];
+	rotation.w = m_rotationW[index];
+	return rotation;
+}
+
+void TransformStore::MarkDirty(uint32_t index)
+{
+	if (m_isDirty[index])
+		return;
+
+	m_isDirty[index] = 1;
+	m_dirty.push_back(index);
+}
+
+glm::mat4 TransformStore::ComputeWorldMatrix(uint32_t index) const
+{
+	// The rotation-matrix of a unit quaternion, scaled, with the translation in the last column
+	const float x = m_rotationX[index], y = m_rotationY[index], z = m_rotationZ[index], w = m_rotationW[index];
+	const float s = m_scale[index];
+
+	glm::mat4 m;
+	m[0] = glm::vec4((1.0f - 2.0f * (y * y + z * z)) * s, 2.0f * (x * y + w * z) * s, 2.0f * (x * z - w * y) * s, 0.0f);
+	m[1] = glm::vec4(2.0f * (x * y - w * z) * s, (1.0f - 2.0f * (x * x + z * z)) * s, 2.0f * (y * z + w * x) * s, 0.0f);
+	m[2] = glm::vec4(2.0f * (x * z + w * y) * s, 2.0f * (y * z - w * x) * s, (1.0f - 2.0f * (x * x + y * y)) * s, 0.0f);
+	m[3] = glm::vec4(m_x[index], m_y[index], m_z[index], 1.0f);
+	return m;
+}
+
+void TransformStore::Update()
+{
+	size_t i = 0;
+
+#if TE_TRANSFORM_SSE
+	// Four transforms at once, gathered from the arrays, computed like ComputeWorldMatrix(), and transposed
+	// from one lane per transform into one column per store
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; i + 4 <= m_dirty.size(); i += 4)
+	{
+		const uint32_t a = m_dirty[i], b = m_dirty[i + 1], c = m_dirty[i + 2], d = m_dirty[i + 3];
+
+		const __m128 x = _mm_setr_ps(m_rotationX[a], m_rotationX[b], m_rotationX[c], m_rotationX[d]);
+		const __m128 y = _mm_setr_ps(m_rotationY[a], m_rotationY[b], m_rotationY[c], m_rotationY[d]);
+		const __m128 z = _mm_setr_ps(m_rotationZ[a], m_rotationZ[b], m_rotationZ[c], m_rotationZ[d]);
+		const __m128 w = _mm_setr_ps(m_rotationW[a], m_rotationW[b], m_rotationW[c], m_rotationW[d]);
+		const __m128 s = _mm_setr_ps(m_scale[a], m_scale[b], m_scale[c], m_scale[d]);
+		const __m128 twoS = _mm_mul_ps(two, s);
+
+		const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		__m128 columns[4][4];
+		columns[0][0] = _mm_sub_ps(s, _mm_mul_ps(twoS, _mm_add_ps(yy, zz)));
+		columns[0][1] = _mm_mul_ps(twoS, _mm_add_ps(xy, wz));
+		columns[0][2] = _mm_mul_ps(twoS, _mm_sub_ps(xz, wy));
+		columns[0][3] = zero;
+
+		columns[1][0] = _mm_mul_ps(twoS, _mm_sub_ps(xy, wz));
+		columns[1][1] = _mm_sub_ps(s, _mm_mul_ps(twoS, _mm_add_ps(xx, zz)));
+		columns[1][2] = _mm_mul_ps(twoS, _mm_add_ps(yz, wx));
+		columns[1][3] = zero;
+
+		columns[2][0] = _mm_mul_ps(twoS, _mm_add_ps(xz, wy));
+		columns[2][1] = _mm_mul_ps(twoS, _mm_sub_ps(yz, wx));
+		columns[2][2] = _mm_sub_ps(s, _mm_mul_ps(twoS, _mm_add_ps(xx, yy)));
+		columns[2][3] = zero;
+
+		columns[3][0] = _mm_setr_ps(m_x[a], m_x[b], m_x[c], m_x[d]);
+		columns[3][1] = _mm_setr_ps(m_y[a], m_y[b], m_y[c], m_y[d]);
+		columns[3][2] = _mm_setr_ps(m_z[a], m_z[b], m_z[c], m_z[d]);
+		columns[3][3] = one;
+
+		const uint32_t indices[4] = { a, b, c, d };
+		for (int column = 0; column < 4; ++column)
+		{
+			_MM_TRANSPOSE4_PS(columns[column][0], columns[column][1], columns[column][2], columns[column][3]);
+
+			for (int j = 0; j < 4; ++j)
+				_mm_storeu_ps(&m_worldMatrices[indices[j]][column][0], columns[column][j]);
+		}
+	}
+#endif
+
+	for (; i < m_dirty.size(); ++i)
+		m_worldMatrices[m_dirty[i]] = ComputeWorldMatrix(m_dirty[i]);
+
+	for (uint32_t index : m_dirty)
+		m_isDirty[index] = 0;
+
+	m_dirty.clear();
+}
\ No newline at end of file
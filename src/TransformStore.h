@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+// Positions, rotations, and uniform scales of objects, kept apart from what's drawn with them. Each is stored
+// as a separate array of floats, and the world-matrices built from them are cached. Changing a transform marks
+// it dirty, and Update() rebuilds the matrices of all dirty transforms together: 4 at a time with SSE.
+class TransformStore
+{
+public:
+	// Returns the index of the new transform
+	uint32_t Add(const glm::vec3& position, const glm::quat& rotation = glm::quat(), float scale = 1.0f);
+
+	void SetPosition(uint32_t index, const glm::vec3& position);
+	void SetRotation(uint32_t index, const glm::quat& rotation);
+	void SetScale(uint32_t index, float scale);
+
+	glm::vec3 GetPosition(uint32_t index) const
+	{
+		return glm::vec3(m_x[index], m_y[index], m_z[index]);
+	}
+
+	glm::quat GetRotation(uint32_t index) const;
+
+	float GetScale(uint32_t index) const
+	{
+		return m_scale[index];
+	}
+
+	size_t GetNumTransforms() const
+	{
+		return m_scale.size();
+	}
+
+	// Rebuilds the world-matrices of the transforms changed since the last call
+	void Update();
+
+	// As of the last Update()
+	const glm::mat4& GetWorldMatrix(uint32_t index) const
+	{
+		return m_worldMatrices[index];
+	}
+
+	// Builds the world-matrix of the current transform, without caching it: translate * rotate * scale
+	glm::mat4 ComputeWorldMatrix(uint32_t index) const;
+
+private:
+	void MarkDirty(uint32_t index);
+
+	// By index
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_z;
+	std::vector<float> m_rotationX;
+	std::vector<float> m_rotationY;
+	std::vector<float> m_rotationZ;
+	std::vector<float> m_rotationW;
+	std::vector<float> m_scale;
+	std::vector<glm::mat4> m_worldMatrices;
+	std::vector<uint8_t> m_isDirty;
+
+	// Indices with m_isDirty set, in the order they were changed
+	std::vector<uint32_t> m_dirty;
+};
\ No newline at end of file
@@ -30,8 +30,14 @@ struct MaterialUBO
 	{
 		HasNormalMap = 1 << 0,
 		HasHeightMap = 1 << 1,
+		DiffuseInArray = 1 << 2,
+		NormalInArray = 1 << 3,
+		HeightInArray = 1 << 4,
 	};
 	glm::uint flags = 0;
+	glm::uint diffuseLayer = 0;
+	glm::uint normalLayer = 0;
+	glm::uint heightLayer = 0;
 };
 
 struct Mesh
@@ -40,4 +40,10 @@ namespace Graphics
 		Generate();
 		glNamedBufferSubDataEXT(m_handle, offset, size, data);
 	}
+
+	void Buffer::CopySubData(const Buffer& source, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size)
+	{
+		Generate();
+		glNamedCopyBufferSubDataEXT(source.GetHandle(), m_handle, readOffset, writeOffset, size);
+	}
 }
\ No newline at end of file
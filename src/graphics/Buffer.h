@@ -18,6 +18,7 @@ namespace Graphics
 
 		void BufferData(GLsizeiptr size, const GLvoid* data, GLenum usage);
 		void BufferSubData(GLintptr offset, GLsizeiptr size, const GLvoid* data);
+		void CopySubData(const Buffer& source, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size);
 		void Delete();	
 
 		GLuint GetHandle() const { return m_handle; }
@@ -3,6 +3,9 @@
 #include <stdint.h>
 #include <cassert>
 #include <cstring> // memcpy
+#include <vector>
+
+#include "Handles.h"
 
 namespace Graphics
 {
@@ -14,16 +17,36 @@ namespace Graphics
 			CreateTexture2D,
 			UploadTexture2D,
 			BindTexture2D,
+			CreateTexture2DArray,
+			AllocateTexture2DArray,
+			UploadTexture2DArrayLayer,
+			UploadTextureRows,
+			BindTexture2DArray,
 			CreateBuffer,
 			UpdateBuffer,
+			UpdateBufferStaged,
 			CreateShaderProgram,
 			CreateRenderTarget,
 			BindRenderTarget,
 			BindRenderTargetTextures,
 			ReloadShaders,
+			ExpectBinding,
+			CreateQuery,
+			BeginQuery,
+			EndQuery,
+			BeginConditionalRender,
+			EndConditionalRender,
+			ReadRenderTarget,
+			ReadBuffer,
 			UseShaderProgram,
 			Draw,
+			SetWriteMask,
 			BindUniformBuffer,
+			BindStorageBuffer,
+			BindImage,
+			BindRenderTargetImage,
+			Dispatch,
+			MemoryBarrier,
 			ClearScreen,
 			End
 		};
@@ -64,6 +87,17 @@ namespace Graphics
 
 		const uint8_t* skip(uint32_t _size);
 
+		// Appends static buffer-data to the frame's staging-area, and returns its offset.
+		// The whole area is uploaded once and copied GPU-side (see Command::UpdateBufferStaged).
+		uint32_t stage(const void* _data, uint32_t _size)
+		{
+			assert(m_size == MAX_SIZE && "Called stage outside start/finish?");
+			uint32_t offset = static_cast<uint32_t>(m_staging.size());
+			const uint8_t* data = reinterpret_cast<const uint8_t*>(_data);
+			m_staging.insert(m_staging.end(), data, data + _size);
+			return offset;
+		}
+
 		void reset()
 		{
 			m_pos = 0;
@@ -73,6 +107,10 @@ namespace Graphics
 		{
 			m_pos = 0;
 			m_size = MAX_SIZE;
+			m_staging.clear(); // Keeps capacity
+			m_queryResults.clear();
+			m_readbacks.clear();
+			m_uploadAreas.clear();
 		}
 
 		void finish()
@@ -87,6 +125,37 @@ namespace Graphics
 		uint32_t m_size;
 		uint8_t  m_buffer[MAX_SIZE];
 
+		std::vector<uint8_t> m_staging;
+
+		// Filled by the rendering-thread with query-results that became available while executing
+		// this buffer; read by the frontend before the buffer is reused (see RenderingSystem::SubmitFrame).
+		struct QueryResult
+		{
+			QueryHandle handle;
+			uint32_t frame; // When the query was issued
+			uint64_t result;
+		};
+		std::vector<QueryResult> m_queryResults;
+
+		// Same as above for readbacks; data is malloc'd by the rendering-thread and freed by the frontend
+		struct Readback
+		{
+			uint32_t id;
+			void* data;
+			uint32_t size;
+		};
+		std::vector<Readback> m_readbacks;
+
+		// Same as above for upload-PBOs mapped by the rendering-thread, which the frontend fills with
+		// texture-rows and hands back through Command::UploadTextureRows
+		struct UploadArea
+		{
+			uint8_t pbo;
+			uint8_t* data;
+			uint32_t size;
+		};
+		std::vector<UploadArea> m_uploadAreas;
+
 	private:
 		CommandBuffer(const CommandBuffer&) = delete;
 		void operator=(const CommandBuffer&) = delete;
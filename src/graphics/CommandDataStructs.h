@@ -2,6 +2,9 @@
 
 #include "Handles.h"
 #include "RenderState.h"
+#include "EnumsFlags.h"
+
+#include <string>
 
 // Used as to avoid having missmatches between reads and writes of commands to the CommandBuffer.
 // (E.g. accidentally writing an uint8_t and reading an uint16_t.)
@@ -17,6 +20,12 @@ namespace Graphics
 		uint32_t elements;
 	};
 
+	struct SetWriteMaskData
+	{
+		ColorMask colorMask;
+		bool depthMask;
+	};
+
 	struct ClearScreenData
 	{
 		Graphics::ClearState clearState;
@@ -28,6 +37,13 @@ namespace Graphics
 		ShaderProgramHandle handle;
 	};
 
+	struct ExpectBindingData
+	{
+		std::string* namePtr;
+		BindingType type;
+		uint16_t index;
+	};
+
 	struct CreateBufferData
 	{
 		BufferHandle handle;
@@ -41,6 +57,13 @@ namespace Graphics
 		BufferType usage;
 	};
 
+	struct UpdateBufferStagedData
+	{
+		BufferHandle buffer;
+		uint32_t offset; // Into the commandbuffer's staging-area
+		uint32_t size;
+	};
+
 	struct CreateTexture2DData
 	{
 		Texture2DHandle handle;
@@ -52,6 +75,50 @@ namespace Graphics
 		Texture2DHandle texture;
 	};
 
+	struct CreateTexture2DArrayData
+	{
+		Texture2DArrayHandle handle;
+	};
+
+	struct AllocateTexture2DArrayData
+	{
+		Texture2DArrayHandle handle;
+		uint16_t width;
+		uint16_t height;
+		uint16_t layers;
+		TextureType type;
+	};
+
+	struct UploadTexture2DArrayLayerData
+	{
+		Texture2DArrayHandle handle;
+		void* data;
+		uint16_t width;
+		uint16_t height;
+		uint16_t layer;
+		bool streamed; // Data is NULL; the rows follow through UploadTextureRows
+	};
+
+	// Followed by 'chunks' TextureRowsData, for the streamed uploads in the order they were issued
+	struct UploadTextureRowsData
+	{
+		uint8_t pbo;
+		uint32_t chunks;
+	};
+
+	struct TextureRowsData
+	{
+		uint32_t offset; // In the PBO
+		uint16_t firstRow;
+		uint16_t rows;
+	};
+
+	struct BindTexture2DArrayData
+	{
+		uint8_t unit;
+		Texture2DArrayHandle texture;
+	};
+
 	struct UseShaderProgramData
 	{
 		ShaderProgramHandle handle;
@@ -64,6 +131,7 @@ namespace Graphics
 		uint16_t width;
 		uint16_t height;
 		TextureType type;
+		bool streamed; // As for UploadTexture2DArrayLayerData
 	};
 
 	struct BindUniformBufferData
@@ -72,6 +140,82 @@ namespace Graphics
 		BufferHandle buffer;
 	};
 
+	struct BindStorageBufferData
+	{
+		uint8_t bindingIndex;
+		BufferHandle buffer;
+	};
+
+	struct BindImageData
+	{
+		uint8_t unit;
+		Texture2DHandle texture;
+		ImageAccess access;
+		TextureType format;
+	};
+
+	struct BindRenderTargetImageData
+	{
+		uint8_t unit;
+		RenderTargetHandle handle;
+		RenderTargetTexture texture;
+		ImageAccess access;
+		TextureType format;
+	};
+
+	struct DispatchData
+	{
+		uint32_t groupsX;
+		uint32_t groupsY;
+		uint32_t groupsZ;
+	};
+
+	struct MemoryBarrierData
+	{
+		uint32_t barriers; // MemoryBarrierBits
+	};
+
+	struct CreateQueryData
+	{
+		QueryHandle handle;
+		QueryType type;
+	};
+
+	struct BeginQueryData
+	{
+		QueryHandle handle;
+		uint32_t frame;
+	};
+
+	struct EndQueryData
+	{
+		QueryHandle handle;
+	};
+
+	struct BeginConditionalRenderData
+	{
+		QueryHandle handle;
+	};
+
+	struct ReadRenderTargetData
+	{
+		uint32_t id;
+		RenderTargetHandle handle;
+		RenderTargetTexture texture;
+		uint16_t x;
+		uint16_t y;
+		uint16_t width;
+		uint16_t height;
+	};
+
+	struct ReadBufferData
+	{
+		uint32_t id;
+		BufferHandle buffer;
+		uint32_t offset;
+		uint32_t size;
+	};
+
 	struct CreateRenderTargetData
 	{
 		RenderTargetHandle handle;
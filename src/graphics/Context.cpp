@@ -3,11 +3,15 @@
 
 #include "CommandBuffer.h"
 #include "ShaderProgram.hpp"
+#include "ShaderPreprocessor.h"
 #include "Handles.h"
 #include "EnumsFlags.h"
 #include "CommandDataStructs.h"
+#include "TextureUtils.h"
 
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 
 namespace Graphics
 {
@@ -30,6 +34,77 @@ namespace Graphics
 				return 0;
 			}
 		}
+
+		GLenum toGL(QueryType type)
+		{
+			switch (type)
+			{
+			case QueryType::TimeElapsed:
+				return GL_TIME_ELAPSED;
+			case QueryType::SamplesPassed:
+				return GL_SAMPLES_PASSED;
+			case QueryType::AnySamplesPassed:
+				return GL_ANY_SAMPLES_PASSED;
+			case QueryType::PrimitivesGenerated:
+				return GL_PRIMITIVES_GENERATED;
+			default:
+				assert(false && "toGL(QueryType) with invalid querytype");
+				return 0;
+			}
+		}
+
+		GLenum toGLImageFormat(TextureType texType)
+		{
+			switch (texType)
+			{
+			case TextureType::RGBA8:
+				return GL_RGBA8;
+			case TextureType::R8:
+				return GL_R8;
+			default:
+				assert(false && "toGLImageFormat(TextureType) with texturetype not usable for images (e.g. SRGB)");
+				return 0;
+			}
+		}
+
+		GLenum toGL(ImageAccess access)
+		{
+			switch (access)
+			{
+			case ImageAccess::ReadOnly:
+				return GL_READ_ONLY;
+			case ImageAccess::WriteOnly:
+				return GL_WRITE_ONLY;
+			default:
+				return GL_READ_WRITE;
+			}
+		}
+
+		GLbitfield toGLBarrierBits(uint32_t barriers)
+		{
+			if (barriers == MemoryBarrierBits::All)
+				return GL_ALL_BARRIER_BITS;
+
+			GLbitfield bits = 0;
+			if (barriers & MemoryBarrierBits::VertexAttribArray) bits |= GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT;
+			if (barriers & MemoryBarrierBits::ElementArray)      bits |= GL_ELEMENT_ARRAY_BARRIER_BIT;
+			if (barriers & MemoryBarrierBits::Uniform)           bits |= GL_UNIFORM_BARRIER_BIT;
+			if (barriers & MemoryBarrierBits::TextureFetch)      bits |= GL_TEXTURE_FETCH_BARRIER_BIT;
+			if (barriers & MemoryBarrierBits::ShaderImageAccess) bits |= GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+			if (barriers & MemoryBarrierBits::Command)           bits |= GL_COMMAND_BARRIER_BIT;
+			if (barriers & MemoryBarrierBits::PixelBuffer)       bits |= GL_PIXEL_BUFFER_BARRIER_BIT;
+			if (barriers & MemoryBarrierBits::TextureUpdate)     bits |= GL_TEXTURE_UPDATE_BARRIER_BIT;
+			if (barriers & MemoryBarrierBits::BufferUpdate)      bits |= GL_BUFFER_UPDATE_BARRIER_BIT;
+			if (barriers & MemoryBarrierBits::Framebuffer)       bits |= GL_FRAMEBUFFER_BARRIER_BIT;
+			if (barriers & MemoryBarrierBits::ShaderStorage)     bits |= GL_SHADER_STORAGE_BARRIER_BIT;
+			return bits;
+		}
+
+		// Queries of types sharing a GL target can't be active at the same time
+		size_t QueryTarget(QueryType type)
+		{
+			return static_cast<size_t>(type == QueryType::AnySamplesPassed ? QueryType::SamplesPassed : type);
+		}
 	}
 	Context::Context()
 	{
@@ -38,6 +113,64 @@ namespace Graphics
 
 	Context::~Context()
 	{
+		for (auto& upload : m_textureUploads)
+		{
+			if (upload.target == GL_TEXTURE_2D)
+				glDeleteTextures(1, &upload.texture);
+		}
+		m_textureUploads.clear();
+
+		for (auto& upload : m_sharedUploads)
+		{
+			if (upload.target == GL_TEXTURE_2D)
+				glDeleteTextures(1, &upload.texture);
+			free(upload.data);
+		}
+		m_sharedUploads.clear();
+
+		for (auto& upload : m_sharedUploadsInFlight)
+		{
+			if (upload.target == GL_TEXTURE_2D)
+				glDeleteTextures(1, &upload.texture);
+			glDeleteSync(upload.fence);
+		}
+		m_sharedUploadsInFlight.clear();
+
+		for (auto& fence : m_uploadFences)
+		{
+			if (fence)
+				glDeleteSync(fence);
+			fence = 0;
+		}
+
+		for (auto& pending : m_pendingReadbacks)
+			glDeleteSync(pending.fence);
+		m_pendingReadbacks.clear();
+		m_freeReadbackPBOs.clear();
+
+		for (auto& pending : m_pendingQueries)
+			glDeleteQueries(1, &pending.query);
+		m_pendingQueries.clear();
+
+		for (auto& query : m_queries)
+		{
+			if (query.active)
+				glDeleteQueries(1, &query.active);
+			query.active = 0;
+
+			// Otherwise still pending (deleted above)
+			if (query.last && query.lastPolled)
+				glDeleteQueries(1, &query.last);
+			query.last = 0;
+		}
+
+		for (auto& pool : m_freeQueries)
+		{
+			if (!pool.empty())
+				glDeleteQueries(static_cast<GLsizei>(pool.size()), pool.data());
+			pool.clear();
+		}
+
 		for (auto& rt : m_renderTargets)
 		{
 			glDeleteTextures(1, &rt.colorTexture);
@@ -53,11 +186,19 @@ namespace Graphics
 			tex = 0;
 		}
 
+		for (auto& tex : m_texture2DArrays)
+		{
+			glDeleteTextures(1, &tex);
+			tex = 0;
+		}
+
 		glDeleteVertexArrays(1, &m_defaultVAO);
 	}
 
-	void Context::Init()
+	void Context::Init(UploadThread* uploadThread)
 	{
+		m_uploadThread = uploadThread;
+
 		glEnable(GL_DEPTH_TEST);
 		glDepthFunc(GL_LESS);
 		glEnable(GL_CULL_FACE);
@@ -66,16 +207,49 @@ namespace Graphics
 		glEnable(GL_FRAMEBUFFER_SRGB);
 
 		m_texture2Ds.fill(0u);
+		m_texture2DArrays.fill(0u);
+		m_texture2DArrayFormats.fill(0u);
+		m_boundTextures.fill(0u);
+		m_boundTextureArrays.fill(0u);
 		m_boundUniformBuffers.fill(0u);
+		m_boundStorageBuffers.fill(0u);
+		m_activeQueryTargets.fill(false);
+		m_uploadFences.fill(0);
+		m_uploadPBOMapped.fill(false);
+
+		Query query = { QueryType::TimeElapsed, 0u, 0u, 0u, false };
+		m_queries.fill(query);
 
 		RenderTarget rt = { 0u, 0u, 0u, 0u };
 		m_renderTargets.fill(rt);
+
+		glGetIntegerv(GL_MAX_IMAGE_UNITS, &m_maxImageUnits);
+
+		// Status-queries only block on programs that aren't complete (see FinishShaderProgramLoads)
+		GLint numExtensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+		for (GLint i = 0; i < numExtensions; ++i)
+		{
+			const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+			if (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 || strcmp(extension, "GL_ARB_parallel_shader_compile") == 0)
+				ShaderProgram::SetParallelCompile(true);
+		}
+
+		if (!m_shaderWatcher.Init())
+			fprintf(stderr, "Shader hot-reload unavailable\n");
 	}
 
 	void Context::ExecuteCommandBuffer(CommandBuffer* cmdBuffer)
 	{
 		cmdBuffer->reset();
 
+		if (!cmdBuffer->m_staging.empty())
+			UploadStagingBuffer(cmdBuffer->m_staging);
+
+		ProcessSharedUploads();
+		FinishShaderProgramLoads();
+		ReloadChangedShaders();
+
 		bool end = false;
 		CommandBuffer::Command command;
 
@@ -119,6 +293,13 @@ namespace Graphics
 				UpdateBuffer(data.buffer, data.data, data.size, glUsage);
 				break;
 			}
+			case CommandBuffer::Command::UpdateBufferStaged:
+			{
+				UpdateBufferStagedData data;
+				cmdBuffer->read(data);
+				UpdateBufferStaged(data.buffer, data.offset, data.size);
+				break;
+			}
 			case CommandBuffer::Command::CreateTexture2D:
 			{
 				CreateTexture2DData data;
@@ -130,7 +311,7 @@ namespace Graphics
 			{
 				UploadTexture2DData data;
 				cmdBuffer->read(data);
-				UpdateTexture2D(data.buffer, data.data, data.width, data.height, data.type);
+				UpdateTexture2D(data.buffer, data.data, data.width, data.height, data.type, data.streamed);
 				break;
 			}
 			case CommandBuffer::Command::BindTexture2D:
@@ -140,6 +321,41 @@ namespace Graphics
 				BindTexture2D(data.unit, data.texture);
 				break;
 			}
+			case CommandBuffer::Command::CreateTexture2DArray:
+			{
+				CreateTexture2DArrayData data;
+				cmdBuffer->read(data);
+				CreateTexture2DArray(data.handle);
+				break;
+			}
+			case CommandBuffer::Command::AllocateTexture2DArray:
+			{
+				AllocateTexture2DArrayData data;
+				cmdBuffer->read(data);
+				AllocateTexture2DArray(data.handle, data.width, data.height, data.layers, data.type);
+				break;
+			}
+			case CommandBuffer::Command::UploadTexture2DArrayLayer:
+			{
+				UploadTexture2DArrayLayerData data;
+				cmdBuffer->read(data);
+				UpdateTexture2DArrayLayer(data.handle, data.layer, data.data, data.width, data.height, data.streamed);
+				break;
+			}
+			case CommandBuffer::Command::UploadTextureRows:
+			{
+				UploadTextureRowsData data;
+				cmdBuffer->read(data);
+				UploadTextureRows(cmdBuffer, data);
+				break;
+			}
+			case CommandBuffer::Command::BindTexture2DArray:
+			{
+				BindTexture2DArrayData data;
+				cmdBuffer->read(data);
+				BindTexture2DArray(data.unit, data.texture);
+				break;
+			}
 			case CommandBuffer::Command::UseShaderProgram:
 			{
 				UseShaderProgramData data;
@@ -154,6 +370,13 @@ namespace Graphics
 				Draw(data.vertexBuffer, data.indexBuffer, data.elements);
 				break;
 			}
+			case CommandBuffer::Command::SetWriteMask:
+			{
+				SetWriteMaskData data;
+				cmdBuffer->read(data);
+				SetWriteMask(data.colorMask, data.depthMask);
+				break;
+			}
 			case CommandBuffer::Command::BindUniformBuffer:
 			{
 				BindUniformBufferData data;
@@ -161,6 +384,42 @@ namespace Graphics
 				BindUniformBuffer(data.bindingIndex, data.buffer);
 				break;
 			}
+			case CommandBuffer::Command::BindStorageBuffer:
+			{
+				BindStorageBufferData data;
+				cmdBuffer->read(data);
+				BindStorageBuffer(data.bindingIndex, data.buffer);
+				break;
+			}
+			case CommandBuffer::Command::BindImage:
+			{
+				BindImageData data;
+				cmdBuffer->read(data);
+				assert(data.texture.handle < MAX_TEXTURES);
+				BindImage(data.unit, m_texture2Ds[data.texture.handle], data.access, data.format);
+				break;
+			}
+			case CommandBuffer::Command::BindRenderTargetImage:
+			{
+				BindRenderTargetImageData data;
+				cmdBuffer->read(data);
+				BindImage(data.unit, GetRenderTargetTexture(data.handle, data.texture), data.access, data.format);
+				break;
+			}
+			case CommandBuffer::Command::Dispatch:
+			{
+				DispatchData data;
+				cmdBuffer->read(data);
+				Dispatch(data.groupsX, data.groupsY, data.groupsZ);
+				break;
+			}
+			case CommandBuffer::Command::MemoryBarrier:
+			{
+				MemoryBarrierData data;
+				cmdBuffer->read(data);
+				MemoryBarrier(data.barriers);
+				break;
+			}
 			case CommandBuffer::Command::CreateRenderTarget:
 			{
 				CreateRenderTargetData data;
@@ -184,13 +443,69 @@ namespace Graphics
 			}
 			case CommandBuffer::Command::ReloadShaders:
 			{
-				for (auto& shader : m_shaderPrograms)
+				for (uint16_t i = 0; i < MAX_SHADERS; ++i)
 				{
-					shader.Reload();
+					if (m_shaderPrograms[i].BeginReload())
+						BeginShaderProgramLoad(i, false);
 				}
 				
 				break;
 			}
+			case CommandBuffer::Command::ExpectBinding:
+			{
+				ExpectBindingData data;
+				cmdBuffer->read(data);
+				m_expectedBindings.push_back({ InternUniformName(*data.namePtr), data.type, data.index });
+				delete data.namePtr;
+				break;
+			}
+			case CommandBuffer::Command::CreateQuery:
+			{
+				CreateQueryData data;
+				cmdBuffer->read(data);
+				CreateQuery(data.handle, data.type);
+				break;
+			}
+			case CommandBuffer::Command::BeginQuery:
+			{
+				BeginQueryData data;
+				cmdBuffer->read(data);
+				BeginQuery(data.handle, data.frame);
+				break;
+			}
+			case CommandBuffer::Command::EndQuery:
+			{
+				EndQueryData data;
+				cmdBuffer->read(data);
+				EndQuery(data.handle);
+				break;
+			}
+			case CommandBuffer::Command::BeginConditionalRender:
+			{
+				BeginConditionalRenderData data;
+				cmdBuffer->read(data);
+				BeginConditionalRender(data.handle);
+				break;
+			}
+			case CommandBuffer::Command::EndConditionalRender:
+			{
+				EndConditionalRender();
+				break;
+			}
+			case CommandBuffer::Command::ReadRenderTarget:
+			{
+				ReadRenderTargetData data;
+				cmdBuffer->read(data);
+				ReadRenderTarget(data.id, data.handle, data.texture, data.x, data.y, data.width, data.height);
+				break;
+			}
+			case CommandBuffer::Command::ReadBuffer:
+			{
+				ReadBufferData data;
+				cmdBuffer->read(data);
+				ReadBuffer(data.id, data.buffer, data.offset, data.size);
+				break;
+			}
 			case CommandBuffer::Command::End: 
 			{
 				end = true;
@@ -201,15 +516,358 @@ namespace Graphics
 				break;
 			}
 		} while (!end);
+
+		MapUploadPBO(cmdBuffer);
+		SubmitSharedUploads();
+		PollQueries(cmdBuffer);
+		PollReadbacks(cmdBuffer);
+	}
+
+	void Context::CreateQuery(const QueryHandle& handle, QueryType type)
+	{
+		assert(handle.handle < MAX_QUERIES);
+		m_queries[handle.handle].type = type;
+	}
+
+	void Context::BeginQuery(const QueryHandle& handle, uint32_t frame)
+	{
+		assert(handle.handle < MAX_QUERIES);
+		assert(handle.IsValid());
+
+		Query& query = m_queries[handle.handle];
+		assert(query.active == 0 && "BeginQuery called twice without EndQuery");
+		assert(!m_activeQueryTargets[QueryTarget(query.type)] && "BeginQuery: a query of this type (or the other samples-type) is already active");
+		m_activeQueryTargets[QueryTarget(query.type)] = true;
+
+		auto& pool = m_freeQueries[static_cast<size_t>(query.type)];
+		if (pool.empty())
+		{
+			glGenQueries(1, &query.active);
+		}
+		else
+		{
+			query.active = pool.back();
+			pool.pop_back();
+		}
+
+		query.frame = frame;
+		glBeginQuery(toGL(query.type), query.active);
+	}
+
+	void Context::EndQuery(const QueryHandle& handle)
+	{
+		assert(handle.handle < MAX_QUERIES);
+		assert(handle.IsValid());
+
+		Query& query = m_queries[handle.handle];
+		assert(query.active != 0 && "EndQuery called without BeginQuery");
+
+		glEndQuery(toGL(query.type));
+		m_activeQueryTargets[QueryTarget(query.type)] = false;
+
+		m_pendingQueries.push_back({ handle, query.type, query.active, query.frame });
+
+		// The previous query-object can be recycled once its result has been read
+		if (query.last && query.lastPolled)
+			m_freeQueries[static_cast<size_t>(query.type)].push_back(query.last);
+
+		query.last = query.active;
+		query.lastPolled = false;
+		query.active = 0;
+	}
+
+	void Context::BeginConditionalRender(const QueryHandle& handle)
+	{
+		assert(handle.handle < MAX_QUERIES);
+		assert(handle.IsValid());
+		assert(!m_conditionalRenderActive && "BeginConditionalRender called twice without EndConditionalRender");
+
+		const Query& query = m_queries[handle.handle];
+		assert(query.type == QueryType::SamplesPassed || query.type == QueryType::AnySamplesPassed);
+
+		if (query.last)
+		{
+			glBeginConditionalRender(query.last, GL_QUERY_NO_WAIT);
+			m_conditionalRenderActive = true;
+		}
+	}
+
+	void Context::EndConditionalRender()
+	{
+		if (m_conditionalRenderActive)
+		{
+			glEndConditionalRender();
+			m_conditionalRenderActive = false;
+		}
+	}
+
+	void Context::PollQueries(CommandBuffer* cmdBuffer)
+	{
+		// Queries complete in issue order, so stop at the first one that isn't available yet
+		while (!m_pendingQueries.empty())
+		{
+			PendingQuery& pending = m_pendingQueries.front();
+
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				break;
+
+			GLuint64 result = 0;
+			glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &result);
+			cmdBuffer->m_queryResults.push_back({ pending.handle, pending.frame, static_cast<uint64_t>(result) });
+
+			// Keep the last query-object of each handle for conditional rendering (see EndQuery)
+			Query& query = m_queries[pending.handle.handle];
+			if (query.last == pending.query)
+				query.lastPolled = true;
+			else
+				m_freeQueries[static_cast<size_t>(pending.type)].push_back(pending.query);
+
+			m_pendingQueries.pop_front();
+		}
+	}
+
+	std::unique_ptr<Buffer> Context::AcquireReadbackPBO(uint32_t size)
+	{
+		std::unique_ptr<Buffer> pbo;
+		if (m_freeReadbackPBOs.empty())
+		{
+			pbo.reset(new Buffer());
+		}
+		else
+		{
+			pbo = std::move(m_freeReadbackPBOs.back());
+			m_freeReadbackPBOs.pop_back();
+		}
+
+		if (pbo->GetSize() < size)
+			pbo->BufferData(size, NULL, GL_STREAM_READ);
+
+		return pbo;
+	}
+
+	void Context::ReadRenderTarget(uint32_t id, const RenderTargetHandle& handle, const RenderTargetTexture& texture, uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+	{
+		assert(handle.handle < MAX_RENDERTARGETS);
+
+		const GLuint fbo = handle.IsValid() ? m_renderTargets[handle.handle].fbo : 0;
+		if (fbo != m_boundFramebuffer)
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+
+		// Read-buffers are per framebuffer and left at their defaults (attachment 0, or the back-buffer),
+		// so only Aux changes it, and restores it below
+		const GLenum defaultReadBuffer = fbo ? GL_COLOR_ATTACHMENT0 : GL_BACK;
+
+		GLenum format = GL_RGBA;
+		GLenum type = GL_UNSIGNED_BYTE;
+
+		switch (texture)
+		{
+		case RenderTargetTexture::Color:
+			break;
+		case RenderTargetTexture::Aux:
+			glFramebufferReadBufferEXT(fbo, GL_COLOR_ATTACHMENT1);
+			break;
+		case RenderTargetTexture::Depth:
+			format = GL_DEPTH_COMPONENT;
+			type = GL_FLOAT;
+			break;
+		}
+
+		const uint32_t size = uint32_t(width) * uint32_t(height) * 4u; // RGBA8 or float
+		std::unique_ptr<Buffer> pbo = AcquireReadbackPBO(size);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo->GetHandle());
+		glReadPixels(x, y, width, height, format, type, NULL);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		if (texture == RenderTargetTexture::Aux)
+			glFramebufferReadBufferEXT(fbo, defaultReadBuffer);
+
+		if (fbo != m_boundFramebuffer)
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, m_boundFramebuffer);
+
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_pendingReadbacks.push_back({ id, std::move(pbo), fence, size });
+	}
+
+	void Context::ReadBuffer(uint32_t id, const BufferHandle& bufferHandle, uint32_t offset, uint32_t size)
+	{
+		assert(bufferHandle.handle < MAX_BUFFERS);
+		assert(bufferHandle.IsValid());
+
+		const Buffer& buffer = m_buffers[bufferHandle.handle];
+		assert(offset + size <= buffer.GetSize());
+
+		std::unique_ptr<Buffer> pbo = AcquireReadbackPBO(size);
+		pbo->CopySubData(buffer, offset, 0, size);
+
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_pendingReadbacks.push_back({ id, std::move(pbo), fence, size });
+	}
+
+	void Context::PollReadbacks(CommandBuffer* cmdBuffer)
+	{
+		// Fences signal in issue order, so stop at the first one that hasn't
+		while (!m_pendingReadbacks.empty())
+		{
+			PendingReadback& pending = m_pendingReadbacks.front();
+
+			if (glClientWaitSync(pending.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+				break;
+
+			glDeleteSync(pending.fence);
+
+			void* data = NULL;
+			const void* mapped = glMapNamedBufferRangeEXT(pending.pbo->GetHandle(), 0, pending.size, GL_MAP_READ_BIT);
+			if (mapped)
+			{
+				data = malloc(pending.size);
+				memcpy(data, mapped, pending.size);
+				glUnmapNamedBufferEXT(pending.pbo->GetHandle());
+			}
+			else
+			{
+				fprintf(stderr, "Context::PollReadbacks: failed to map PBO.\n");
+			}
+
+			// The callback is always invoked so the frontend can release it
+			cmdBuffer->m_readbacks.push_back({ pending.id, data, data ? pending.size : 0u });
+
+			m_freeReadbackPBOs.push_back(std::move(pending.pbo));
+			m_pendingReadbacks.pop_front();
+		}
 	}
 
 	void Context::CreateShaderProgram(const ShaderProgramHandle& handle, const ShaderInfo& si)
 	{
 		assert(handle.handle < MAX_SHADERS);
-		if (!m_shaderPrograms[handle.handle].Load(si))
+		m_shaderPrograms[handle.handle].BeginLoad(si);
+		BeginShaderProgramLoad(handle.handle, true);
+	}
+
+	void Context::BeginShaderProgramLoad(uint16_t program, bool created)
+	{
+		WatchShaderProgram(program);
+
+		for (PendingProgram& pending : m_pendingPrograms)
+		{
+			if (pending.program == program)
+			{
+				pending.created |= created;
+				return;
+			}
+		}
+
+		m_pendingPrograms.push_back({ program, created });
+	}
+
+	void Context::FinishShaderProgramLoads()
+	{
+		for (size_t i = 0; i < m_pendingPrograms.size(); )
+		{
+			const PendingProgram pending = m_pendingPrograms[i];
+			ShaderProgram& program = m_shaderPrograms[pending.program];
+
+			// Still compiling; without KHR_parallel_shader_compile this is never the case, but programs
+			// have then at least been issued together one commandbuffer earlier
+			if (program.IsLoadPending() && !program.IsLoadComplete())
+			{
+				++i;
+				continue;
+			}
+
+			m_pendingPrograms[i] = m_pendingPrograms.back();
+			m_pendingPrograms.pop_back();
+
+			// Errors are reported by FinishLoad; a reloaded program keeps its previous version
+			const bool success = program.FinishLoad();
+			if (!success && pending.created && !program.IsLoaded())
+			{
+				// Fail-fast on shader-compilation errors
+				exit(1); 
+			}
+
+			if (success)
+				ValidateBindings(pending.program);
+
+			if (success && !pending.created)
+				printf("Reloaded shader-program %u\n", pending.program);
+		}
+	}
+
+	void Context::ValidateBindings(uint16_t program)
+	{
+		static const char* typeNames[] = { "sampler", "uniform-block", "storage-block", "image" };
+
+		const ShaderProgram& shaderProgram = m_shaderPrograms[program];
+		const std::vector<std::string>& files = shaderProgram.GetDependencies();
+
+		for (const ShaderReflection::Binding& binding : shaderProgram.GetReflection().bindings)
+		{
+			// Images are bound to image-units (see BindImage), which are fewer than texture-units
+			if (binding.type == BindingType::Image && binding.index >= m_maxImageUnits)
+			{
+				fprintf(stderr, "Shader-program %u (%s): image '%s' is bound to %d, but there are only %d image-units\n", program, files.empty() ? "" : files.front().c_str(),
+					GetUniformName(binding.id).c_str(), binding.index, m_maxImageUnits);
+			}
+
+			for (const ExpectedBinding& expected : m_expectedBindings)
+			{
+				if (expected.id != binding.id || expected.type != binding.type || expected.index == binding.index)
+					continue;
+
+				fprintf(stderr, "Shader-program %u (%s): %s '%s' is bound to %d, expected %u\n", program, files.empty() ? "" : files.front().c_str(),
+					typeNames[static_cast<int>(binding.type)], GetUniformName(binding.id).c_str(), binding.index, expected.index);
+			}
+		}
+	}
+
+	void Context::WatchShaderProgram(uint16_t program)
+	{
+		for (const std::string& file : m_shaderPrograms[program].GetDependencies())
+		{
+			std::vector<uint16_t>& dependents = m_shaderDependents[file];
+			if (std::find(dependents.begin(), dependents.end(), program) != dependents.end())
+				continue;
+
+			if (dependents.empty())
+				m_shaderWatcher.Watch(file);
+
+			dependents.push_back(program);
+		}
+	}
+
+	void Context::ReloadChangedShaders()
+	{
+		m_changedShaderFiles.clear();
+		m_shaderWatcher.Poll(m_changedShaderFiles);
+
+		if (m_changedShaderFiles.empty())
+			return;
+
+		std::vector<uint16_t> programs;
+		for (const std::string& file : m_changedShaderFiles)
+		{
+			ShaderPreprocessor::Invalidate(file);
+
+			const auto& f = m_shaderDependents.find(file);
+			if (f == m_shaderDependents.end())
+				continue;
+
+			for (uint16_t program : f->second)
+			{
+				if (std::find(programs.begin(), programs.end(), program) == programs.end())
+					programs.push_back(program);
+			}
+		}
+
+		for (uint16_t program : programs)
 		{
-			// Fail-fast on shader-compilation errors
-			exit(1); 
+			// Finished by FinishShaderProgramLoads, which also watches any changed includes
+			if (m_shaderPrograms[program].BeginReload())
+				BeginShaderProgramLoad(program, false);
 		}
 	}
 
@@ -217,7 +875,10 @@ namespace Graphics
 	{
 		ShaderProgram& program = m_shaderPrograms[handle.handle];
 
-		if (program.IsLoaded())
+		// Draws and dispatches are skipped until the program has finished loading
+		m_currentProgramReady = program.IsLoaded();
+
+		if (m_currentProgramReady)
 			program.UseProgram();
 		else
 			glUseProgram(0);
@@ -243,6 +904,30 @@ namespace Graphics
 		free(data);
 	}
 
+	void Context::UploadStagingBuffer(const std::vector<uint8_t>& staging)
+	{
+		const GLsizeiptr size = static_cast<GLsizeiptr>(staging.size());
+
+		// Respecifying the store orphans the previous one, so copies still reading it don't stall
+		m_stagingBuffer.BufferData(size, staging.data(), GL_STREAM_DRAW);
+	}
+
+	void Context::UpdateBufferStaged(const BufferHandle& bufferHandle, uint32_t offset, uint32_t size)
+	{
+		assert(bufferHandle.handle < MAX_BUFFERS);
+		assert(bufferHandle.IsValid());
+		assert(offset + size <= m_stagingBuffer.GetSize());
+
+		Buffer& buffer = m_buffers[bufferHandle.handle];
+		assert(buffer.IsGenerated());
+
+		// Only (re)allocate storage when the size changes; the copy itself is ordered on the GPU
+		if (buffer.GetSize() != size)
+			buffer.BufferData(size, NULL, GL_STATIC_DRAW);
+
+		buffer.CopySubData(m_stagingBuffer, offset, 0, size);
+	}
+
 	void Context::BindTexture2D(uint8_t unit, const Texture2DHandle& tex)
 	{
 		assert(tex.handle < MAX_TEXTURES);
@@ -259,6 +944,21 @@ namespace Graphics
 		}
 	}
 
+	void Context::BindTexture2DArray(uint8_t unit, const Texture2DArrayHandle& tex)
+	{
+		assert(tex.handle < MAX_TEXTURE_ARRAYS);
+		_BindTexture2DArray(unit, m_texture2DArrays[tex.handle]);
+	}
+
+	void Context::_BindTexture2DArray(uint8_t unit, GLuint tex)
+	{
+		if (m_boundTextureArrays[unit] != tex)
+		{
+			m_boundTextureArrays[unit] = tex;
+			glBindMultiTextureEXT(GL_TEXTURE0 + unit, GL_TEXTURE_2D_ARRAY, tex);
+		}
+	}
+
 	void Context::CreateRenderTarget(const RenderTargetHandle& handle, const RenderTargetOptions& options)
 	{
 		assert(handle.handle < MAX_RENDERTARGETS);
@@ -318,38 +1018,43 @@ namespace Graphics
 		if (!handle.IsValid())
 		{
 			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			m_boundFramebuffer = 0;
 			return;
 		}
 
 		auto& rt = m_renderTargets[handle.handle];
 		glBindFramebuffer(GL_FRAMEBUFFER, rt.fbo);
+		m_boundFramebuffer = rt.fbo;
 	}
 
 	void Context::BindRenderTargetTexture(uint8_t unit, const RenderTargetHandle& handle, const RenderTargetTexture& texture)
+	{
+		_BindTexture2D(unit, GetRenderTargetTexture(handle, texture));
+	}
+
+	GLuint Context::GetRenderTargetTexture(const RenderTargetHandle& handle, const RenderTargetTexture& texture)
 	{
 		assert(handle.handle < MAX_RENDERTARGETS);
 		auto& rt = m_renderTargets[handle.handle];
 
-		GLuint toBind = 0;
-
 		switch (texture)
 		{
 		case RenderTargetTexture::Color:
-			toBind = rt.colorTexture;
-			break;
+			return rt.colorTexture;
 		case RenderTargetTexture::Depth:
-			toBind = rt.depthTexture;
-			break;
+			return rt.depthTexture;
 		case RenderTargetTexture::Aux:
-			toBind = rt.auxTexture;
-			break;
+			return rt.auxTexture;
 		}
 
-		_BindTexture2D(unit, toBind);
+		return 0;
 	}
 
 	void Context::Draw(const BufferHandle& v, const BufferHandle& i, uint32_t elements)
 	{
+		if (!m_currentProgramReady)
+			return;
+
 		if (m_defaultVAO == 0)
 			glGenVertexArrays(1, &m_defaultVAO);
 
@@ -392,6 +1097,21 @@ namespace Graphics
 		}
 	}
 
+	void Context::SetWriteMask(const ColorMask& colorMask, bool depthMask)
+	{
+		if (m_currentRenderState.colorMask != colorMask)
+		{
+			m_currentRenderState.colorMask = colorMask;
+			glColorMask(colorMask.red, colorMask.green, colorMask.blue, colorMask.alpha);
+		}
+
+		if (m_currentRenderState.depthMask != depthMask)
+		{
+			m_currentRenderState.depthMask = depthMask;
+			glDepthMask(depthMask);
+		}
+	}
+
 	void Context::BindUniformBuffer(uint8_t index, BufferHandle buffer)
 	{
 		assert(buffer.handle < MAX_BUFFERS);
@@ -404,6 +1124,36 @@ namespace Graphics
 		}
 	}
 
+	void Context::BindStorageBuffer(uint8_t index, BufferHandle buffer)
+	{
+		assert(buffer.handle < MAX_BUFFERS);
+		GLuint bufferGLuint = m_buffers[buffer.handle].GetHandle();
+
+		if (m_boundStorageBuffers[index] != bufferGLuint)
+		{
+			m_boundStorageBuffers[index] = bufferGLuint;
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, bufferGLuint);
+		}
+	}
+
+	void Context::BindImage(uint8_t unit, GLuint texture, ImageAccess access, TextureType format)
+	{
+		glBindImageTexture(unit, texture, 0, GL_FALSE, 0, toGL(access), toGLImageFormat(format));
+	}
+
+	void Context::Dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ)
+	{
+		if (!m_currentProgramReady)
+			return;
+
+		glDispatchCompute(groupsX, groupsY, groupsZ);
+	}
+
+	void Context::MemoryBarrier(uint32_t barriers)
+	{
+		glMemoryBarrier(toGLBarrierBits(barriers));
+	}
+
 	void Context::CreateTexture2D(const Texture2DHandle& tex)
 	{
 		assert(tex.handle < MAX_TEXTURES);
@@ -413,34 +1163,284 @@ namespace Graphics
 			glGenTextures(1, &glUint);
 	}
 
-	void Context::UpdateTexture2D(const Texture2DHandle& tex, void* data, uint16_t width, uint16_t height, TextureType type)
+	void Context::UpdateTexture2D(const Texture2DHandle& tex, void* data, uint16_t width, uint16_t height, TextureType type, bool streamed)
 	{
 		assert(tex.handle < MAX_TEXTURES);
-		auto& glUint = m_texture2Ds[tex.handle];
+		assert(m_texture2Ds[tex.handle] != 0);
+		assert(type != TextureType::Depth && type != TextureType::None);
+		assert(width * 4u <= TEXTURE_UPLOAD_BUDGET && "UpdateTexture2D: a single row exceeds the upload-budget");
+
+		GLuint texture = 0;
+		glGenTextures(1, &texture);
+		glTextureStorage2DEXT(texture, GL_TEXTURE_2D, NumMipLevels(width, height), toGL(type), width, height);
+
+		glTextureParameteriEXT(texture, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+		glTextureParameteriEXT(texture, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameterfEXT(texture, GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 32.0f);
+
+		if (streamed)
+		{
+			// Rows arrive through the upload-PBOs (see UploadTextureRows)
+			TextureUpload upload;
+			upload.handle = tex;
+			upload.texture = texture;
+			upload.target = GL_TEXTURE_2D;
+			upload.format = toGL(type);
+			upload.layer = 0;
+			upload.width = width;
+			upload.height = height;
+			upload.rowsUploaded = 0;
+			m_textureUploads.push_back(upload);
+			return;
+		}
+
+		if (!data)
+		{
+			// Nothing to upload
+			ReplaceTexture2D(tex, texture);
+			return;
+		}
+
+		assert(m_uploadThread && "UpdateTexture2D: data must be streamed without an upload-thread");
+		m_sharedUploads.push_back({ tex, texture, GL_TEXTURE_2D, toGL(type), 0, data, width, height });
+	}
+
+	void Context::CreateTexture2DArray(const Texture2DArrayHandle& tex)
+	{
+		assert(tex.handle < MAX_TEXTURE_ARRAYS);
+		auto& glUint = m_texture2DArrays[tex.handle];
 
+		if (glUint == 0)
+			glGenTextures(1, &glUint);
+	}
+
+	void Context::AllocateTexture2DArray(const Texture2DArrayHandle& tex, uint16_t width, uint16_t height, uint16_t layers, TextureType type)
+	{
+		assert(tex.handle < MAX_TEXTURE_ARRAYS);
+		assert(type != TextureType::Depth && type != TextureType::None);
+
+		GLuint glUint = m_texture2DArrays[tex.handle];
 		assert(glUint != 0);
 
-		GLenum internalFormat = toGL(type);
+		glTextureStorage3DEXT(glUint, GL_TEXTURE_2D_ARRAY, NumMipLevels(width, height), toGL(type), width, height, layers);
+		m_texture2DArrayFormats[tex.handle] = toGL(type);
 
-		glTextureImage2DEXT(
-			glUint,
-			GL_TEXTURE_2D,
-			0, // Level
-			internalFormat,
-			width, height,
-			0, // Border (must be 0)
-			GL_RGBA, // Format
-			GL_UNSIGNED_BYTE, // Buffer type
-			data);
+		// Layers sample opaque black (like an unloaded texture) until their data arrives
+		const uint8_t black[4] = { 0, 0, 0, 255 };
+		ClearTexture2DArray(glUint, width, height, layers, black);
 
-		// Not done correctly for SRGB-textures with AMD driver 13.20.16-130926a-163066E-ATI
-		glGenerateTextureMipmapEXT(glUint, GL_TEXTURE_2D);
+		glTextureParameteriEXT(glUint, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+		glTextureParameteriEXT(glUint, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameterfEXT(glUint, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, 32.0f);
+	}
 
-		glTextureParameteriEXT(glUint, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-		glTextureParameteriEXT(glUint, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTextureParameterfEXT(glUint, GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 32.0f);
+	void Context::UpdateTexture2DArrayLayer(const Texture2DArrayHandle& tex, uint16_t layer, void* data, uint16_t width, uint16_t height, bool streamed)
+	{
+		assert(tex.handle < MAX_TEXTURE_ARRAYS);
+		assert(m_texture2DArrays[tex.handle] != 0);
+		assert(data || streamed);
+		assert(width * 4u <= TEXTURE_UPLOAD_BUDGET && "UpdateTexture2DArrayLayer: a single row exceeds the upload-budget");
 
-		free(data);
+		if (!streamed)
+		{
+			assert(m_uploadThread && "UpdateTexture2DArrayLayer: data must be streamed without an upload-thread");
+			m_sharedUploads.push_back({ Texture2DHandle::Invalid(), m_texture2DArrays[tex.handle], GL_TEXTURE_2D_ARRAY, 
+				m_texture2DArrayFormats[tex.handle], layer, data, width, height });
+			return;
+		}
+
+		// Rows arrive through the upload-PBOs (see UploadTextureRows)
+		TextureUpload upload;
+		upload.handle = Texture2DHandle::Invalid();
+		upload.texture = m_texture2DArrays[tex.handle];
+		upload.target = GL_TEXTURE_2D_ARRAY;
+		upload.format = m_texture2DArrayFormats[tex.handle];
+		upload.layer = layer;
+		upload.width = width;
+		upload.height = height;
+		upload.rowsUploaded = 0;
+		m_textureUploads.push_back(upload);
+	}
+
+	void Context::ReplaceTexture2D(const Texture2DHandle& tex, GLuint texture)
+	{
+		auto& glUint = m_texture2Ds[tex.handle];
+
+		// Deleting a bound texture unbinds it, so keep the shadowed state in sync
+		for (auto& bound : m_boundTextures)
+		{
+			if (bound == glUint)
+				bound = 0;
+		}
+
+		glDeleteTextures(1, &glUint);
+		glUint = texture;
+	}
+
+	void Context::SubmitSharedUploads()
+	{
+		if (m_sharedUploads.empty())
+			return;
+
+		// The upload-context waits (on the GPU) for the textures created above
+		GLsync ready = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+
+		m_uploadThread->Submit(m_sharedUploads, ready);
+	}
+
+	void Context::ProcessSharedUploads()
+	{
+		if (!m_uploadThread)
+			return;
+
+		m_uploadThread->TakeCompleted(m_sharedUploadsInFlight);
+
+		// Fences from the upload-context signal in order, so stop at the first that hasn't
+		size_t done = 0;
+		for (; done < m_sharedUploadsInFlight.size(); ++done)
+		{
+			const UploadThread::Completed& upload = m_sharedUploadsInFlight[done];
+
+			if (glClientWaitSync(upload.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+				break;
+
+			glDeleteSync(upload.fence);
+
+			if (upload.target == GL_TEXTURE_2D)
+			{
+				ReplaceTexture2D(upload.handle, upload.texture);
+			}
+			else
+			{
+				// Changes from another context are only guaranteed visible after rebinding
+				for (auto& bound : m_boundTextureArrays)
+				{
+					if (bound == upload.texture)
+						bound = 0;
+				}
+			}
+		}
+
+		m_sharedUploadsInFlight.erase(m_sharedUploadsInFlight.begin(), m_sharedUploadsInFlight.begin() + done);
+	}
+
+	void Context::MapUploadPBO(CommandBuffer* cmdBuffer)
+	{
+		// Uploads are only streamed without an upload-thread
+		if (m_uploadThread)
+			return;
+
+		// Still held by the frontend, which had no rows to copy
+		if (m_uploadPBOMapped[m_currentUploadPBO])
+			return;
+
+		Buffer& pbo = m_uploadPBOs[m_currentUploadPBO];
+		GLsync& fence = m_uploadFences[m_currentUploadPBO];
+
+		if (fence)
+		{
+			// Never stall; retry next frame if the GPU hasn't consumed this PBO yet
+			const GLenum waitResult = glClientWaitSync(fence, 0, 0);
+			if (waitResult == GL_TIMEOUT_EXPIRED)
+				return;
+
+			if (waitResult == GL_WAIT_FAILED)
+			{
+				// Whether the GPU is done with this PBO is unknown, so it's skipped (and retried next time around)
+				fprintf(stderr, "Context::MapUploadPBO: waiting on the fence of PBO %d failed.\n", m_currentUploadPBO);
+				m_currentUploadPBO = (m_currentUploadPBO + 1) % NUM_UPLOAD_PBOS;
+				return;
+			}
+
+			glDeleteSync(fence);
+			fence = 0;
+		}
+
+		if (pbo.GetSize() != TEXTURE_UPLOAD_BUDGET)
+			pbo.BufferData(TEXTURE_UPLOAD_BUDGET, NULL, GL_STREAM_DRAW);
+
+		// Safe to map unsynchronized since the fence above has signaled. Stays mapped (and unused by GL) 
+		// while the frontend writes to it.
+		uint8_t* mapped = static_cast<uint8_t*>(glMapNamedBufferRangeEXT(pbo.GetHandle(), 0, TEXTURE_UPLOAD_BUDGET,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+
+		if (!mapped)
+		{
+			fprintf(stderr, "Context::MapUploadPBO: failed to map PBO.\n");
+			return;
+		}
+
+		m_uploadPBOMapped[m_currentUploadPBO] = true;
+		cmdBuffer->m_uploadAreas.push_back({ static_cast<uint8_t>(m_currentUploadPBO), mapped, TEXTURE_UPLOAD_BUDGET });
+
+		m_currentUploadPBO = (m_currentUploadPBO + 1) % NUM_UPLOAD_PBOS;
+	}
+
+	void Context::UploadTextureRows(CommandBuffer* cmdBuffer, const UploadTextureRowsData& data)
+	{
+		assert(data.pbo < NUM_UPLOAD_PBOS);
+		assert(m_uploadPBOMapped[data.pbo] && "UploadTextureRows: PBO isn't held by the frontend");
+
+		Buffer& pbo = m_uploadPBOs[data.pbo];
+
+		glUnmapNamedBufferEXT(pbo.GetHandle());
+		m_uploadPBOMapped[data.pbo] = false;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo.GetHandle());
+
+		// Chunks continue the oldest unfinished upload; the frontend copies rows in the same order
+		size_t current = 0;
+		for (uint32_t i = 0; i < data.chunks; ++i)
+		{
+			TextureRowsData chunk;
+			cmdBuffer->read(chunk);
+
+			assert(current < m_textureUploads.size());
+			TextureUpload& upload = m_textureUploads[current];
+			assert(chunk.firstRow == upload.rowsUploaded);
+
+			const GLvoid* offset = reinterpret_cast<const GLvoid*>(static_cast<uintptr_t>(chunk.offset));
+
+			if (upload.target == GL_TEXTURE_2D_ARRAY)
+			{
+				glTextureSubImage3DEXT(upload.texture, GL_TEXTURE_2D_ARRAY, 0,
+					0, chunk.firstRow, upload.layer, upload.width, chunk.rows, 1,
+					GL_RGBA, GL_UNSIGNED_BYTE, offset);
+			}
+			else
+			{
+				glTextureSubImage2DEXT(upload.texture, GL_TEXTURE_2D, 0,
+					0, chunk.firstRow, upload.width, chunk.rows,
+					GL_RGBA, GL_UNSIGNED_BYTE, offset);
+			}
+
+			upload.rowsUploaded += chunk.rows;
+			if (upload.rowsUploaded == upload.height)
+				++current;
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		m_uploadFences[data.pbo] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		// Swap in completed textures
+		while (!m_textureUploads.empty() && m_textureUploads.front().rowsUploaded == m_textureUploads.front().height)
+		{
+			TextureUpload upload = m_textureUploads.front();
+			m_textureUploads.pop_front();
+
+			if (upload.target == GL_TEXTURE_2D_ARRAY)
+			{
+				GenerateLayerMipmaps(upload.texture, upload.format, upload.layer, upload.width, upload.height);
+				continue;
+			}
+
+			// Not done correctly for SRGB-textures with AMD driver 13.20.16-130926a-163066E-ATI
+			glGenerateTextureMipmapEXT(upload.texture, GL_TEXTURE_2D);
+
+			ReplaceTexture2D(upload.handle, upload.texture);
+		}
 	}
 
 	void Context::Clear(const ClearState& clearState)
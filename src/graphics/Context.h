@@ -1,16 +1,26 @@
 #pragma once
 
 #include <array>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
 
 #include "EnumsFlags.h"
 #include "Handles.h"
 #include "Buffer.h"
 #include "RenderState.h"
 #include "ShaderProgram.hpp"
+#include "UploadThread.h"
+#include "ShaderWatcher.h"
+
+#undef MemoryBarrier // windows.h
 
 namespace Graphics
 {
 	struct CommandBuffer;
+	struct UploadTextureRowsData;
 
 	class Context
 	{
@@ -18,41 +28,180 @@ namespace Graphics
 		Context();
 		~Context();
 
-		void Init();
+		// Texture-data is uploaded by 'uploadThread' if given, otherwise streamed by this context
+		void Init(UploadThread* uploadThread = nullptr);
 		void ExecuteCommandBuffer(CommandBuffer* ptr);
 
 	private:
 		void Clear(const ClearState& clearState);
 		void CreateShaderProgram(const ShaderProgramHandle& handle, const ShaderInfo& si);
 		void UseShaderProgram(const ShaderProgramHandle& handle);
+		void BeginShaderProgramLoad(uint16_t program, bool created);
+		void FinishShaderProgramLoads();
+		void ValidateBindings(uint16_t program);
+		void WatchShaderProgram(uint16_t program);
+		void ReloadChangedShaders();
 		void CreateBuffer(const BufferHandle& buffer);
 		void UpdateBuffer(const BufferHandle& buffer, void* data, uint32_t size, GLenum usage);
+		void UploadStagingBuffer(const std::vector<uint8_t>& staging);
+		void UpdateBufferStaged(const BufferHandle& buffer, uint32_t offset, uint32_t size);
 		void CreateTexture2D(const Texture2DHandle& buffer);
-		void UpdateTexture2D(const Texture2DHandle& tex, void* data, uint16_t width, uint16_t height, TextureType type);
+		void UpdateTexture2D(const Texture2DHandle& tex, void* data, uint16_t width, uint16_t height, TextureType type, bool streamed);
 		void BindTexture2D(uint8_t unit, const Texture2DHandle& tex);
+		void ReplaceTexture2D(const Texture2DHandle& tex, GLuint texture);
+		void CreateTexture2DArray(const Texture2DArrayHandle& tex);
+		void AllocateTexture2DArray(const Texture2DArrayHandle& tex, uint16_t width, uint16_t height, uint16_t layers, TextureType type);
+		void UpdateTexture2DArrayLayer(const Texture2DArrayHandle& tex, uint16_t layer, void* data, uint16_t width, uint16_t height, bool streamed);
+		void BindTexture2DArray(uint8_t unit, const Texture2DArrayHandle& tex);
+		void UploadTextureRows(CommandBuffer* cmdBuffer, const UploadTextureRowsData& data);
+		void MapUploadPBO(CommandBuffer* cmdBuffer);
+		void SubmitSharedUploads();
+		void ProcessSharedUploads();
+		void CreateQuery(const QueryHandle& handle, QueryType type);
+		void BeginQuery(const QueryHandle& handle, uint32_t frame);
+		void EndQuery(const QueryHandle& handle);
+		void PollQueries(CommandBuffer* cmdBuffer);
+		void BeginConditionalRender(const QueryHandle& handle);
+		void EndConditionalRender();
+		void ReadRenderTarget(uint32_t id, const RenderTargetHandle& handle, const RenderTargetTexture& texture, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+		void ReadBuffer(uint32_t id, const BufferHandle& buffer, uint32_t offset, uint32_t size);
+		std::unique_ptr<Buffer> AcquireReadbackPBO(uint32_t size);
+		void PollReadbacks(CommandBuffer* cmdBuffer);
 		void Draw(const BufferHandle& v, const BufferHandle& i, uint32_t elements);
+		void SetWriteMask(const ColorMask& colorMask, bool depthMask);
 		void BindUniformBuffer(uint8_t index, BufferHandle buffer);
+		void BindStorageBuffer(uint8_t index, BufferHandle buffer);
+		void BindImage(uint8_t unit, GLuint texture, ImageAccess access, TextureType format);
+		void Dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ);
+		void MemoryBarrier(uint32_t barriers);
 		void CreateRenderTarget(const RenderTargetHandle& handle, const RenderTargetOptions& options);
 		void BindRenderTarget(const RenderTargetHandle& handle);
 		void BindRenderTargetTexture(uint8_t unit, const RenderTargetHandle& handle, const RenderTargetTexture& texture);
+		GLuint GetRenderTargetTexture(const RenderTargetHandle& handle, const RenderTargetTexture& texture);
 
 		void _BindTexture2D(uint8_t unit, GLuint tex);
+		void _BindTexture2DArray(uint8_t unit, GLuint tex);
 
 		ClearState m_currentClearState;
+		RenderState m_currentRenderState; // Only the write-masks are applied through it so far
 
 		static const int MAX_SHADERS = 4096;
 		std::array<ShaderProgram, 4096> m_shaderPrograms;
 
+		// Programs are reloaded when one of their source- or include-files changes. Entries are only
+		// added, so a file a program stopped including may still trigger a (harmless) reload.
+		ShaderWatcher m_shaderWatcher;
+		std::unordered_map<std::string, std::vector<uint16_t>> m_shaderDependents;
+		std::vector<std::string> m_changedShaderFiles;
+
+		// Programs are compiled and linked without waiting, and finished once the driver is done
+		struct PendingProgram
+		{
+			uint16_t program;
+			bool created; // Not a reload; failing is fatal
+		};
+		std::vector<PendingProgram> m_pendingPrograms;
+		bool m_currentProgramReady = false;
+
+		// Reported on load if a program binds these elsewhere (see RenderingSystem::ExpectBinding)
+		struct ExpectedBinding
+		{
+			UniformId id;
+			BindingType type;
+			uint16_t index;
+		};
+		std::vector<ExpectedBinding> m_expectedBindings;
+		GLint m_maxImageUnits = 0;
+
 		static const int MAX_BUFFERS = 32000;
 		std::array<Graphics::Buffer, MAX_BUFFERS> m_buffers;
 
+		// Holds the current commandbuffer's staging-area (static uploads)
+		Graphics::Buffer m_stagingBuffer;
+
 		static const int MAX_TEXTURES = 4096;
 		std::array<GLuint, MAX_TEXTURES> m_texture2Ds;
 
+		static const int MAX_TEXTURE_ARRAYS = 256;
+		std::array<GLuint, MAX_TEXTURE_ARRAYS> m_texture2DArrays;
+		std::array<GLenum, MAX_TEXTURE_ARRAYS> m_texture2DArrayFormats; // Internal formats, for layer-views
+
+		// Without an upload-thread, texture-data is streamed through a ring of PBOs, at most 
+		// TEXTURE_UPLOAD_BUDGET bytes per frame. One PBO per frame is mapped and handed to the frontend, 
+		// which copies rows into it and hands it back (see RenderingSystem::UpdateTexture2D).
+		// 2D-uploads go to a new texture which replaces the handle's texture once complete;
+		// array-uploads go directly to their layer.
+		struct TextureUpload
+		{
+			Texture2DHandle handle;
+			GLuint texture;
+			GLenum target;
+			GLenum format; // Internal format, used by array-layers
+			uint16_t layer;
+			uint16_t width;
+			uint16_t height;
+			uint16_t rowsUploaded;
+		};
+		std::deque<TextureUpload> m_textureUploads;
+
+		// Uploads handed to the upload-thread at the end of the commandbuffer, and those it has finished
+		// (adopted once their fences have signaled)
+		UploadThread* m_uploadThread = nullptr;
+		std::vector<UploadThread::Job> m_sharedUploads;
+		std::vector<UploadThread::Completed> m_sharedUploadsInFlight;
+
+		static const int NUM_UPLOAD_PBOS = 3;
+		static const uint32_t TEXTURE_UPLOAD_BUDGET = 4 << 20; // Also the size of each PBO
+		std::array<Graphics::Buffer, NUM_UPLOAD_PBOS> m_uploadPBOs;
+		std::array<GLsync, NUM_UPLOAD_PBOS> m_uploadFences;
+		std::array<bool, NUM_UPLOAD_PBOS> m_uploadPBOMapped; // Held by the frontend
+		int m_currentUploadPBO = 0;
+
+		// Every Begin/End-pair uses its own GL query-object from a per-type pool, so a handle can be
+		// re-issued every frame without waiting for its previous results.
+		struct Query
+		{
+			QueryType type;
+			GLuint active; // Between Begin and End
+			uint32_t frame;
+			GLuint last; // Most recently ended, used for conditional rendering
+			bool lastPolled;
+		};
+
+		static const int MAX_QUERIES = 1024;
+		std::array<Query, MAX_QUERIES> m_queries;
+
+		struct PendingQuery
+		{
+			QueryHandle handle;
+			QueryType type;
+			GLuint query;
+			uint32_t frame;
+		};
+		std::deque<PendingQuery> m_pendingQueries; // In issue order
+		std::array<std::vector<GLuint>, static_cast<size_t>(QueryType::Count)> m_freeQueries;
+		std::array<bool, static_cast<size_t>(QueryType::Count)> m_activeQueryTargets; // By QueryTarget (see Context.cpp)
+		bool m_conditionalRenderActive = false;
+
+		// Readbacks are copied into pixel-pack buffers on the GPU and mapped once their fence has signaled.
+		// PBOs are recycled in FIFO order; the pool grows instead of stalling if all are in flight.
+		struct PendingReadback
+		{
+			uint32_t id;
+			std::unique_ptr<Buffer> pbo;
+			GLsync fence;
+			uint32_t size;
+		};
+		std::deque<PendingReadback> m_pendingReadbacks;
+		std::vector<std::unique_ptr<Buffer>> m_freeReadbackPBOs;
+
 		GLuint m_defaultVAO = 0;
+		GLuint m_boundFramebuffer = 0; // As read- and draw-framebuffer, by BindRenderTarget
 
 		std::array<GLuint, 32> m_boundTextures;
+		std::array<GLuint, 32> m_boundTextureArrays;
 		std::array<GLuint, 32> m_boundUniformBuffers;
+		std::array<GLuint, 32> m_boundStorageBuffers;
 
 		struct RenderTarget
 		{
@@ -18,6 +18,49 @@ namespace Graphics
 		Color, Depth, Aux
 	};
 
+	enum class QueryType : uint8_t
+	{
+		TimeElapsed,         // Nanoseconds
+		SamplesPassed,
+		AnySamplesPassed,    // 0 or 1
+		PrimitivesGenerated,
+		Count
+	};
+
+	// Shader-resources bound by index (layout(binding = N)), see RenderingSystem::ExpectBinding
+	enum class BindingType : uint8_t
+	{
+		Sampler,      // Texture-unit
+		UniformBlock,
+		StorageBlock,
+		Image         // Image-unit, separate from texture-units
+	};
+
+	enum class ImageAccess : uint8_t
+	{
+		ReadOnly, WriteOnly, ReadWrite
+	};
+
+	// Which kinds of accesses must see writes done by shaders before the barrier (combine with |)
+	struct MemoryBarrierBits
+	{
+		enum Enum : uint32_t
+		{
+			VertexAttribArray = 1 << 0,
+			ElementArray = 1 << 1,
+			Uniform = 1 << 2,
+			TextureFetch = 1 << 3,
+			ShaderImageAccess = 1 << 4,
+			Command = 1 << 5,
+			PixelBuffer = 1 << 6,
+			TextureUpdate = 1 << 7,
+			BufferUpdate = 1 << 8,
+			Framebuffer = 1 << 9,
+			ShaderStorage = 1 << 10,
+			All = 0xFFFFFFFF
+		};
+	};
+
 	struct RenderTargetOptions
 	{
 		static RenderTargetOptions SRGB8Depth(int w, int h) 
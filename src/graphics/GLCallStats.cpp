@@ -0,0 +1,139 @@
+#include "GLCallStats.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+
+namespace Graphics
+{
+	namespace GLCallStats
+	{
+		std::atomic<bool> g_enabled{ false };
+
+		namespace
+		{
+			const size_t TOP_OFFENDERS = 10;
+
+			struct Registry
+			{
+				std::mutex mutex;
+				std::deque<Entry> entries; // Stable references
+				std::deque<std::string> names;
+
+				uint32_t frames = 0;
+				std::chrono::steady_clock::time_point lastReport = std::chrono::steady_clock::now();
+			};
+
+			Registry& GetRegistry()
+			{
+				static Registry registry;
+				return registry;
+			}
+
+			void Reset(Registry& registry)
+			{
+				for (auto& entry : registry.entries)
+				{
+					entry.calls = 0;
+					entry.nanoseconds = 0;
+				}
+
+				registry.frames = 0;
+				registry.lastReport = std::chrono::steady_clock::now();
+			}
+
+			void Report(Registry& registry)
+			{
+				std::vector<Entry*> sorted;
+				uint64_t totalCalls = 0;
+				uint64_t totalNanoseconds = 0;
+
+				for (auto& entry : registry.entries)
+				{
+					if (entry.calls == 0)
+						continue;
+
+					sorted.push_back(&entry);
+					totalCalls += entry.calls;
+					totalNanoseconds += entry.nanoseconds;
+				}
+
+				std::sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b)
+				{
+					return a->nanoseconds > b->nanoseconds;
+				});
+
+				const double frames = registry.frames;
+
+				printf("---GL CALLS PER FRAME (avg. over %u frames)---\n", registry.frames);
+				printf("%-36s %10s %10s\n", "Entry point", "Calls", "us");
+
+				for (size_t i = 0; i < std::min(sorted.size(), TOP_OFFENDERS); ++i)
+				{
+					const Entry& entry = *sorted[i];
+					printf("%-36s %10.1f %10.1f\n", entry.name, entry.calls / frames, entry.nanoseconds / frames / 1000.0);
+				}
+
+				printf("%-36s %10.1f %10.1f\n", "Total", totalCalls / frames, totalNanoseconds / frames / 1000.0);
+				printf("----------------------------------------------\n");
+			}
+		}
+
+		void SetEnabled(bool enabled)
+		{
+			Registry& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+
+			Reset(registry);
+			g_enabled = enabled;
+		}
+
+		Entry& Register(const char* name)
+		{
+			// GLEW's function-pointers are named e.g. __glewDrawArraysInstanced
+			std::string glName = name;
+			if (glName.compare(0, 6, "__glew") == 0)
+				glName = "gl" + glName.substr(6);
+
+			Registry& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+
+			for (auto& entry : registry.entries)
+			{
+				if (glName == entry.name)
+					return entry;
+			}
+
+			registry.names.push_back(glName);
+			registry.entries.emplace_back();
+
+			Entry& entry = registry.entries.back();
+			entry.name = registry.names.back().c_str();
+			entry.calls = 0;
+			entry.nanoseconds = 0;
+
+			return entry;
+		}
+
+		void EndFrame()
+		{
+			if (!IsEnabled())
+				return;
+
+			Registry& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+
+			++registry.frames;
+
+			if (std::chrono::steady_clock::now() - registry.lastReport > std::chrono::seconds(1))
+			{
+				Report(registry);
+				Reset(registry);
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <utility>
+
+namespace Graphics
+{
+	// Counts and times every GL-call made through OpenGL.h, and prints the most expensive
+	// entry points once per second. Compiled in with TE_GL_CALL_STATS; when disabled at 
+	// runtime the only overhead per call is a relaxed atomic load and a branch.
+	namespace GLCallStats
+	{
+		struct Entry
+		{
+			const char* name;
+			std::atomic<uint64_t> calls;
+			std::atomic<uint64_t> nanoseconds;
+		};
+
+		extern std::atomic<bool> g_enabled;
+
+		inline bool IsEnabled()
+		{
+			return g_enabled.load(std::memory_order_relaxed);
+		}
+
+		void SetEnabled(bool enabled);
+
+		// Returns the (shared) entry for a GL entry point; takes either "glFoo" or GLEW's "__glewFoo"
+		Entry& Register(const char* name);
+
+		// Call when a frame's GL-calls have been issued (after swapping buffers)
+		void EndFrame();
+
+		struct ScopedTimer
+		{
+			ScopedTimer(Entry& entry) : m_entry(entry), m_start(std::chrono::high_resolution_clock::now())
+			{ }
+
+			~ScopedTimer()
+			{
+				auto elapsed = std::chrono::high_resolution_clock::now() - m_start;
+				m_entry.calls.fetch_add(1, std::memory_order_relaxed);
+				m_entry.nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), std::memory_order_relaxed);
+			}
+
+			Entry& m_entry;
+			std::chrono::high_resolution_clock::time_point m_start;
+		};
+	}
+
+	template<typename F>
+	struct GLCallProxy
+	{
+		template<typename... Args>
+		auto operator()(Args... args) const -> decltype(std::declval<F>()(args...))
+		{
+			if (!GLCallStats::IsEnabled())
+				return function(args...);
+
+			GLCallStats::ScopedTimer timer(entry);
+			return function(args...);
+		}
+
+		// Allows passing GL-functions as function-pointers (those calls aren't counted)
+		operator F() const
+		{
+			return function;
+		}
+
+		F function;
+		GLCallStats::Entry& entry;
+	};
+
+	template<typename F>
+	inline GLCallProxy<F> MakeGLCallProxy(F function, GLCallStats::Entry& entry)
+	{
+		return{ function, entry };
+	}
+}
+
+// One registration per call-site (function-local static), then shared by name
+#define TE_GL_CALL(function, name) \
+	Graphics::MakeGLCallProxy(function, []() -> Graphics::GLCallStats::Entry& { \
+		static Graphics::GLCallStats::Entry& entry = Graphics::GLCallStats::Register(name); \
+		return entry; \
+	}())
@@ -26,6 +26,8 @@ namespace Graphics
 	TE_HANDLE(BufferHandle);
 	TE_HANDLE(VertexArrayHandle);
 	TE_HANDLE(Texture2DHandle);
+	TE_HANDLE(Texture2DArrayHandle);
+	TE_HANDLE(QueryHandle);
 
 	TE_HANDLE(RenderTargetHandle);
 	inline const RenderTargetHandle DefaultRenderTarget() { return Graphics::RenderTargetHandle::Invalid(); };
@@ -0,0 +1,247 @@
+#include "HeadlessContext.h"
+#include "RenderingSystem.h"
+
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <initializer_list>
+
+#if TE_HEADLESS_EGL
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace Graphics
+{
+#if TE_HEADLESS_EGL
+	namespace
+	{
+		bool HasExtension(const char* extensions, const char* name)
+		{
+			if (!extensions)
+				return false;
+
+			const size_t length = strlen(name);
+			for (const char* s = strstr(extensions, name); s; s = strstr(s + length, name))
+			{
+				if ((s == extensions || s[-1] == ' ') && (s[length] == ' ' || s[length] == '\0'))
+					return true;
+			}
+
+			return false;
+		}
+
+		EGLDisplay GetDisplay()
+		{
+			// Prefer Mesa's surfaceless platform; needs neither X11/Wayland nor a GPU
+			const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+			if (HasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+			{
+				auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+				if (getPlatformDisplay)
+				{
+					EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+					if (display != EGL_NO_DISPLAY)
+						return display;
+				}
+			}
+
+			return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		}
+
+		EGLConfig ChooseConfig(EGLDisplay display, const ContextConfig& cc)
+		{
+			const EGLint colorBits = static_cast<EGLint>(std::min(cc.colorBits, 24u) / 3);
+
+			// Retry without multisampling, which software rasterizers often don't offer for pbuffers
+			for (unsigned int samples : { cc.msaaSamples, 0u })
+			{
+				const EGLint attribs[] = {
+					EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+					EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+					EGL_RED_SIZE, colorBits,
+					EGL_GREEN_SIZE, colorBits,
+					EGL_BLUE_SIZE, colorBits,
+					EGL_DEPTH_SIZE, static_cast<EGLint>(cc.depthBits),
+					EGL_STENCIL_SIZE, static_cast<EGLint>(cc.stencilBits),
+					EGL_SAMPLE_BUFFERS, samples > 0 ? 1 : 0,
+					EGL_SAMPLES, static_cast<EGLint>(samples),
+					EGL_NONE
+				};
+
+				EGLConfig config;
+				EGLint numConfigs = 0;
+				if (eglChooseConfig(display, attribs, &config, 1, &numConfigs) && numConfigs > 0)
+					return config;
+			}
+
+			return NULL;
+		}
+	}
+#endif
+
+	HeadlessContext::~HeadlessContext()
+	{
+		Destroy();
+	}
+
+	bool HeadlessContext::Init(int width, int height, const ContextConfig& cc)
+	{
+#if TE_HEADLESS_EGL
+		EGLDisplay display = GetDisplay();
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+		{
+			fprintf(stderr, "HeadlessContext: no EGL display.\n");
+			return false;
+		}
+		m_display = display;
+		m_ownsDisplay = true;
+
+		if (!eglBindAPI(EGL_OPENGL_API))
+		{
+			fprintf(stderr, "HeadlessContext: EGL does not support desktop OpenGL.\n");
+			Destroy();
+			return false;
+		}
+
+		EGLConfig config = ChooseConfig(display, cc);
+		if (!config)
+		{
+			fprintf(stderr, "HeadlessContext: no matching EGL config.\n");
+			Destroy();
+			return false;
+		}
+		m_config = config;
+
+		const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+
+		std::vector<EGLint> surfaceAttribs = { EGL_WIDTH, width, EGL_HEIGHT, height };
+		if (HasExtension(extensions, "EGL_KHR_gl_colorspace"))
+		{
+			// Like GLFW_SRGB_CAPABLE for windows
+			surfaceAttribs.push_back(EGL_GL_COLORSPACE_KHR);
+			surfaceAttribs.push_back(EGL_GL_COLORSPACE_SRGB_KHR);
+		}
+		surfaceAttribs.push_back(EGL_NONE);
+
+		m_surface = eglCreatePbufferSurface(display, config, surfaceAttribs.data());
+		if (m_surface == EGL_NO_SURFACE)
+		{
+			fprintf(stderr, "HeadlessContext: eglCreatePbufferSurface failed.\n");
+			Destroy();
+			return false;
+		}
+
+		const EGLint contextAttribs[] = {
+			EGL_CONTEXT_MAJOR_VERSION_KHR, 4,
+			EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, cc.coreProfileContext ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT_KHR,
+			EGL_CONTEXT_FLAGS_KHR, cc.debugContext ? EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR : 0,
+			EGL_NONE
+		};
+		static_assert(sizeof(contextAttribs) == sizeof(m_contextAttribs), "Context-attributes don't fit");
+		memcpy(m_contextAttribs, contextAttribs, sizeof(contextAttribs)); // For InitShared
+
+		m_context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+		if (m_context == EGL_NO_CONTEXT)
+		{
+			fprintf(stderr, "HeadlessContext: eglCreateContext failed (OpenGL 4.3 required).\n");
+			Destroy();
+			return false;
+		}
+
+		return true;
+#else
+		(void)width;
+		(void)height;
+		(void)cc;
+		fprintf(stderr, "HeadlessContext: not supported in this build (requires TE_HEADLESS_EGL).\n");
+		return false;
+#endif
+	}
+
+	bool HeadlessContext::InitShared(const HeadlessContext& share)
+	{
+#if TE_HEADLESS_EGL
+		assert(share.m_context);
+
+		m_display = share.m_display;
+		m_config = share.m_config;
+		m_ownsDisplay = false;
+		memcpy(m_contextAttribs, share.m_contextAttribs, sizeof(m_contextAttribs));
+
+		const EGLint surfaceAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		m_surface = eglCreatePbufferSurface(m_display, m_config, surfaceAttribs);
+		if (m_surface == EGL_NO_SURFACE)
+		{
+			fprintf(stderr, "HeadlessContext: eglCreatePbufferSurface failed.\n");
+			Destroy();
+			return false;
+		}
+
+		m_context = eglCreateContext(m_display, m_config, share.m_context, m_contextAttribs);
+		if (m_context == EGL_NO_CONTEXT)
+		{
+			fprintf(stderr, "HeadlessContext: eglCreateContext failed for shared context.\n");
+			Destroy();
+			return false;
+		}
+
+		return true;
+#else
+		(void)share;
+		return false;
+#endif
+	}
+
+	void HeadlessContext::Destroy()
+	{
+#if TE_HEADLESS_EGL
+		if (!m_display)
+			return;
+
+		if (eglGetCurrentContext() == m_context)
+			eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+		if (m_context)
+			eglDestroyContext(m_display, m_context);
+
+		if (m_surface)
+			eglDestroySurface(m_display, m_surface);
+
+		// A shared context's display is terminated by the context it shares with
+		if (m_ownsDisplay)
+			eglTerminate(m_display);
+#endif
+		m_display = m_config = m_surface = m_context = nullptr;
+		m_ownsDisplay = false;
+	}
+
+	bool HeadlessContext::MakeCurrent()
+	{
+#if TE_HEADLESS_EGL
+		return eglMakeCurrent(m_display, m_surface, m_surface, m_context) == EGL_TRUE;
+#else
+		return false;
+#endif
+	}
+
+	void HeadlessContext::ReleaseCurrent()
+	{
+#if TE_HEADLESS_EGL
+		eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+#endif
+	}
+
+	void HeadlessContext::SwapBuffers()
+	{
+#if TE_HEADLESS_EGL
+		// No-op for pbuffers, but marks the end of the frame for tools
+		eglSwapBuffers(m_display, m_surface);
+#endif
+	}
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+namespace Graphics
+{
+	struct ContextConfig;
+
+	// An OpenGL-context without a window (WindowMode::HEADLESS), for batch-rendering and benchmarks 
+	// on machines without a display. Rendering goes to a pbuffer which acts as the default rendertarget.
+	// Only available when built with TE_HEADLESS_EGL (EGL, e.g. Mesa's llvmpipe); Init fails otherwise.
+	class HeadlessContext
+	{
+	public:
+		HeadlessContext() = default;
+		~HeadlessContext();
+
+		HeadlessContext(const HeadlessContext&) = delete;
+		HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+		bool Init(int width, int height, const ContextConfig& cc);
+		void Destroy();
+
+		// Creates a context sharing objects with 'share' (already initialized), with a minimal surface
+		bool InitShared(const HeadlessContext& share);
+
+		// Like glfwMakeContextCurrent, the context can only be current on one thread at a time
+		bool MakeCurrent();
+		void ReleaseCurrent();
+		void SwapBuffers();
+
+	private:
+		// EGLDisplay, EGLConfig, EGLSurface and EGLContext
+		void* m_display = nullptr;
+		void* m_config = nullptr;
+		void* m_surface = nullptr;
+		void* m_context = nullptr;
+		int m_contextAttribs[9];
+		bool m_ownsDisplay = false;
+	};
+}
\ No newline at end of file
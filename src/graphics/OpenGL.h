@@ -1,3 +1,46 @@
 #pragma once
 #include <GL/glew.h>
-#include <GLFW/glfw3.h>
\ No newline at end of file
+#include <GLFW/glfw3.h>
+
+// Per-frame GL-call statistics (see GLCallStats.h), toggled at runtime
+#ifndef TE_GL_CALL_STATS
+#define TE_GL_CALL_STATS 1
+#endif
+
+#if TE_GL_CALL_STATS
+#include "GLCallStats.h"
+
+#undef GLEW_GET_FUN
+#define GLEW_GET_FUN(x) TE_GL_CALL(x, #x)
+
+// GL 1.1 entry points are exported directly, not through GLEW_GET_FUN
+#define glBindTexture(...)    TE_GL_CALL(glBindTexture, "glBindTexture")(__VA_ARGS__)
+#define glClear(...)          TE_GL_CALL(glClear, "glClear")(__VA_ARGS__)
+#define glClearColor(...)     TE_GL_CALL(glClearColor, "glClearColor")(__VA_ARGS__)
+#define glClearDepth(...)     TE_GL_CALL(glClearDepth, "glClearDepth")(__VA_ARGS__)
+#define glClearStencil(...)   TE_GL_CALL(glClearStencil, "glClearStencil")(__VA_ARGS__)
+#define glColorMask(...)      TE_GL_CALL(glColorMask, "glColorMask")(__VA_ARGS__)
+#define glCullFace(...)       TE_GL_CALL(glCullFace, "glCullFace")(__VA_ARGS__)
+#define glDeleteTextures(...) TE_GL_CALL(glDeleteTextures, "glDeleteTextures")(__VA_ARGS__)
+#define glDepthFunc(...)      TE_GL_CALL(glDepthFunc, "glDepthFunc")(__VA_ARGS__)
+#define glDepthMask(...)      TE_GL_CALL(glDepthMask, "glDepthMask")(__VA_ARGS__)
+#define glDisable(...)        TE_GL_CALL(glDisable, "glDisable")(__VA_ARGS__)
+#define glDrawArrays(...)     TE_GL_CALL(glDrawArrays, "glDrawArrays")(__VA_ARGS__)
+#define glDrawElements(...)   TE_GL_CALL(glDrawElements, "glDrawElements")(__VA_ARGS__)
+#define glEnable(...)         TE_GL_CALL(glEnable, "glEnable")(__VA_ARGS__)
+#define glFinish(...)         TE_GL_CALL(glFinish, "glFinish")(__VA_ARGS__)
+#define glFlush(...)          TE_GL_CALL(glFlush, "glFlush")(__VA_ARGS__)
+#define glFrontFace(...)      TE_GL_CALL(glFrontFace, "glFrontFace")(__VA_ARGS__)
+#define glGenTextures(...)    TE_GL_CALL(glGenTextures, "glGenTextures")(__VA_ARGS__)
+#define glGetError(...)       TE_GL_CALL(glGetError, "glGetError")(__VA_ARGS__)
+#define glGetIntegerv(...)    TE_GL_CALL(glGetIntegerv, "glGetIntegerv")(__VA_ARGS__)
+#define glPixelStorei(...)    TE_GL_CALL(glPixelStorei, "glPixelStorei")(__VA_ARGS__)
+#define glReadBuffer(...)     TE_GL_CALL(glReadBuffer, "glReadBuffer")(__VA_ARGS__)
+#define glReadPixels(...)     TE_GL_CALL(glReadPixels, "glReadPixels")(__VA_ARGS__)
+#define glViewport(...)       TE_GL_CALL(glViewport, "glViewport")(__VA_ARGS__)
+#endif
+
+// GL_KHR_parallel_shader_compile is newer than the bundled GLEW
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "ProgramBinaryCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#ifdef _WIN32
+#include <direct.h> // _mkdir
+#else
+#include <sys/stat.h> // mkdir
+#endif
+
+namespace Graphics
+{
+	namespace ProgramBinaryCache
+	{
+		namespace
+		{
+			const uint32_t MAGIC = 0x42504554; // "TEPB"
+			const uint32_t VERSION = 1;
+
+			struct Header
+			{
+				uint32_t magic;
+				uint32_t version;
+				uint64_t key;
+				uint32_t format;
+				uint32_t length;
+			};
+
+			std::string g_directory;
+			bool g_directoryCreated = false;
+
+			// FNV-1a; stable across runs and compilers, unlike std::hash
+			uint64_t Hash(uint64_t hash, const void* data, size_t size)
+			{
+				const uint8_t* bytes = static_cast<const uint8_t*>(data);
+				for (size_t i = 0; i < size; ++i)
+				{
+					hash ^= bytes[i];
+					hash *= 1099511628211ull;
+				}
+				return hash;
+			}
+
+			uint64_t Hash(uint64_t hash, const std::string& str)
+			{
+				// Include the length so ("ab", "c") and ("a", "bc") differ
+				const uint64_t length = str.size();
+				hash = Hash(hash, &length, sizeof(length));
+				return Hash(hash, str.data(), str.size());
+			}
+
+			std::string GetString(GLenum name)
+			{
+				const GLubyte* str = glGetString(name);
+				return str ? reinterpret_cast<const char*>(str) : "";
+			}
+
+			std::string GetFilename(uint64_t key)
+			{
+				char name[32];
+				snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+				return g_directory + name;
+			}
+
+			void EnsureDirectory()
+			{
+				if (g_directoryCreated)
+					return;
+
+				// Fails harmlessly if it already exists; opening the file will tell
+#ifdef _WIN32
+				_mkdir(g_directory.c_str());
+#else
+				mkdir(g_directory.c_str(), 0755);
+#endif
+				g_directoryCreated = true;
+			}
+		}
+
+		void SetDirectory(const std::string& directory)
+		{
+			g_directory = directory;
+			if (!g_directory.empty() && g_directory.back() != '/' && g_directory.back() != '\\')
+				g_directory += '/';
+
+			g_directoryCreated = false;
+		}
+
+		bool IsEnabled()
+		{
+			return !g_directory.empty();
+		}
+
+		uint64_t ComputeKey(const std::vector<std::pair<GLenum, std::string>>& sources)
+		{
+			// A binary is only valid for the driver that produced it
+			static const std::string driver = GetString(GL_VENDOR) + "|" + GetString(GL_RENDERER) + "|" + GetString(GL_VERSION);
+
+			uint64_t hash = 14695981039346656037ull;
+			hash = Hash(hash, driver);
+
+			for (const auto& source : sources)
+			{
+				const uint32_t type = source.first;
+				hash = Hash(hash, &type, sizeof(type));
+				hash = Hash(hash, source.second);
+			}
+
+			return hash;
+		}
+
+		bool Load(GLuint program, uint64_t key)
+		{
+			if (!IsEnabled())
+				return false;
+
+			std::ifstream file(GetFilename(key), std::ios::binary);
+			if (!file)
+				return false;
+
+			Header header;
+			if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || 
+				header.magic != MAGIC || header.version != VERSION || header.key != key)
+			{
+				return false;
+			}
+
+			std::vector<char> binary(header.length);
+			if (!file.read(binary.data(), binary.size()))
+				return false;
+
+			glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+			// Drivers may reject binaries (e.g. after an update that kept the version-string)
+			GLint linkStatus = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+			return linkStatus == GL_TRUE;
+		}
+
+		void Store(GLuint program, uint64_t key)
+		{
+			if (!IsEnabled())
+				return;
+
+			GLint length = 0;
+			glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+			if (length <= 0)
+				return;
+
+			std::vector<char> binary(length);
+			GLenum format = 0;
+			glGetProgramBinary(program, length, NULL, &format, binary.data());
+
+			EnsureDirectory();
+
+			const std::string filename = GetFilename(key);
+			std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+			if (!file)
+			{
+				fprintf(stderr, "ProgramBinaryCache: couldn't write %s\n", filename.c_str());
+				return;
+			}
+
+			Header header = { MAGIC, VERSION, key, format, static_cast<uint32_t>(length) };
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(binary.data(), binary.size());
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "OpenGL.h"
+
+namespace Graphics
+{
+	// On-disk cache of linked programs (glGetProgramBinary/glProgramBinary), keyed by a hash of the 
+	// fully preprocessed sources and the driver (vendor, renderer and version). Entries are validated 
+	// on load; anything stale, corrupt or rejected by the driver falls back to compiling from source.
+	// Only used from the rendering-thread.
+	namespace ProgramBinaryCache
+	{
+		// Empty disables the cache. Set before any program is loaded.
+		void SetDirectory(const std::string& directory);
+		bool IsEnabled();
+
+		// Sources are (shader-type, preprocessed source)-pairs; needs a current context
+		uint64_t ComputeKey(const std::vector<std::pair<GLenum, std::string>>& sources);
+
+		// Returns true if 'program' was successfully linked from a cached binary
+		bool Load(GLuint program, uint64_t key);
+
+		// Call after linking with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+		void Store(GLuint program, uint64_t key);
+	}
+}
\ No newline at end of file
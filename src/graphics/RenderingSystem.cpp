@@ -8,9 +8,20 @@
 #include "CommandBuffer.h"
 #include "EnumsFlags.h"
 #include "CommandDataStructs.h"
+#include "HeadlessContext.h"
+#include "UploadThread.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderArchive.h"
+
+#include <unordered_map>
+#include <deque>
+#include <chrono>
 
 #define TE_MULTI_THREADED 1
 
+// Defined by glew.c but only declared in GLEW_MX-builds; loads GL entry points without glewInit's GLX-part
+extern "C" GLenum GLEWAPIENTRY glewContextInit(void);
+
 static void APIENTRY OGLDebugFunc(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, GLvoid* userParam);
 static void GLFWErrorCallback(int error, const char* message);
 
@@ -35,6 +46,10 @@ namespace Graphics
 			case RenderingSystem::Key::F1: glfwKey = GLFW_KEY_F1; break;
 			case RenderingSystem::Key::F2: glfwKey = GLFW_KEY_F2; break;
 			case RenderingSystem::Key::F3: glfwKey = GLFW_KEY_F3; break;
+			case RenderingSystem::Key::F4: glfwKey = GLFW_KEY_F4; break;
+			case RenderingSystem::Key::F5: glfwKey = GLFW_KEY_F5; break;
+			case RenderingSystem::Key::F6: glfwKey = GLFW_KEY_F6; break;
+			case RenderingSystem::Key::F7: glfwKey = GLFW_KEY_F7; break;
 			case RenderingSystem::Key::SHIFT: glfwKey = GLFW_KEY_LEFT_SHIFT; break;
 			default:
 				fprintf(stderr, "toGLFW(RenderingSystem::Key k): Invalid key\n");
@@ -51,7 +66,34 @@ namespace Graphics
 			return m_commandBuffers[m_currentCommandBuffer];
 		};
 
-		GLFWwindow* m_windowHandle;
+		GLFWwindow* m_windowHandle = nullptr;
+
+		// Instead of the window in WindowMode::HEADLESS
+		std::unique_ptr<HeadlessContext> m_headlessContext;
+		std::chrono::steady_clock::time_point m_startTime;
+
+		std::unique_ptr<UploadThread> m_uploadThread;
+
+		// Without the upload-thread, texture-rows are copied straight into upload-PBOs mapped by the 
+		// rendering-thread (see Context.h). One is handed back per frame, with the rows copied into it, 
+		// which keeps uploads within its size per frame; rows that don't fit yet wait in a copy.
+		std::deque<CommandBuffer::UploadArea> m_uploadAreas;
+		uint32_t m_uploadAreaUsed = 0;
+		std::vector<TextureRowsData> m_uploadChunks; // Copied into the front area this frame
+
+		struct StreamedUpload
+		{
+			uint8_t* rows; // Copy of the rows from 'firstRow' on
+			uint32_t rowSize;
+			uint16_t firstRow;
+			uint16_t rowsCopied;
+			uint16_t height;
+		};
+		std::deque<StreamedUpload> m_streamedUploads;
+
+		uint16_t CopyRows(const uint8_t* rows, uint32_t rowSize, uint16_t firstRow, uint16_t height);
+		void StreamRows(const void* data, uint32_t rowSize, uint16_t height);
+		void FlushUploadRows(CommandBuffer& cmdBuff);
 
 		int m_currentCommandBuffer = 0;
 		std::array<CommandBuffer, 2> m_commandBuffers;
@@ -59,7 +101,26 @@ namespace Graphics
 		uint16_t m_numShaderPrograms = 0;
 		uint16_t m_numBuffers = 0;
 		uint16_t m_numTexture2D = 0;
+		uint16_t m_numTexture2DArrays = 0;
 		uint16_t m_numRenderTargets = 0;
+		uint16_t m_numQueries = 0;
+
+		struct QueryResultState
+		{
+			bool available = false;
+			uint32_t frame = 0;
+			uint64_t result = 0;
+		};
+		std::vector<QueryResultState> m_queryResults; // Indexed by handle
+
+		uint32_t m_readbackId = 0;
+		std::unordered_map<uint32_t, ReadbackCallback> m_readbackCallbacks;
+
+		uint32_t m_frameNumber = 0;
+
+		// Write-masks carry over between frames, like all state
+		ColorMask m_colorMask;
+		bool m_depthMask = true;
 
 		bool m_keyState[static_cast<int>(Key::LAST_KEY)];
 		bool m_oldKeyState[static_cast<int>(Key::LAST_KEY)];
@@ -71,6 +132,78 @@ namespace Graphics
 #endif
 	};
 
+	uint16_t RenderingSystem::RenderingSystem_data::CopyRows(const uint8_t* rows, uint32_t rowSize, uint16_t firstRow, uint16_t height)
+	{
+		if (m_uploadAreas.empty())
+			return 0;
+
+		const CommandBuffer::UploadArea& area = m_uploadAreas.front();
+		assert(rowSize <= area.size && "CopyRows: a single row exceeds the upload-budget");
+
+		const uint32_t count = std::min<uint32_t>(height - firstRow, (area.size - m_uploadAreaUsed) / rowSize);
+		if (count == 0)
+			return 0;
+
+		memcpy(area.data + m_uploadAreaUsed, rows, count * rowSize);
+		m_uploadChunks.push_back({ m_uploadAreaUsed, firstRow, static_cast<uint16_t>(count) });
+		m_uploadAreaUsed += count * rowSize;
+
+		return static_cast<uint16_t>(count);
+	}
+
+	void RenderingSystem::RenderingSystem_data::StreamRows(const void* data, uint32_t rowSize, uint16_t height)
+	{
+		const uint8_t* rows = static_cast<const uint8_t*>(data);
+
+		// Straight into the frame's area, unless earlier uploads are still waiting for room
+		uint16_t copied = 0;
+		if (m_streamedUploads.empty())
+			copied = CopyRows(rows, rowSize, 0, height);
+
+		if (copied == height)
+			return;
+
+		const size_t size = static_cast<size_t>(height - copied) * rowSize;
+		uint8_t* rest = static_cast<uint8_t*>(malloc(size));
+		assert(rest && "rest StreamRows");
+		memcpy(rest, rows + static_cast<size_t>(copied) * rowSize, size);
+
+		m_streamedUploads.push_back({ rest, rowSize, copied, copied, height });
+	}
+
+	void RenderingSystem::RenderingSystem_data::FlushUploadRows(CommandBuffer& cmdBuff)
+	{
+		// Fill the rest of the frame's area with waiting rows, in order
+		while (!m_streamedUploads.empty())
+		{
+			StreamedUpload& upload = m_streamedUploads.front();
+			const uint8_t* rows = upload.rows + static_cast<size_t>(upload.rowsCopied - upload.firstRow) * upload.rowSize;
+			upload.rowsCopied += CopyRows(rows, upload.rowSize, upload.rowsCopied, upload.height);
+
+			if (upload.rowsCopied < upload.height)
+				break;
+
+			free(upload.rows);
+			m_streamedUploads.pop_front();
+		}
+
+		if (m_uploadChunks.empty())
+			return;
+
+		UploadTextureRowsData data;
+		data.pbo = m_uploadAreas.front().pbo;
+		data.chunks = static_cast<uint32_t>(m_uploadChunks.size());
+
+		cmdBuff.write(CommandBuffer::Command::UploadTextureRows);
+		cmdBuff.write(data);
+		for (const TextureRowsData& chunk : m_uploadChunks)
+			cmdBuff.write(chunk);
+
+		m_uploadAreas.pop_front();
+		m_uploadAreaUsed = 0;
+		m_uploadChunks.clear();
+	}
+
 	RenderingSystem::RenderingSystem()
 	{
 
@@ -85,53 +218,72 @@ namespace Graphics
 	{
 		m_data.reset(new RenderingSystem_data);
 
-		glfwSetErrorCallback(GLFWErrorCallback);
-
-		if (!glfwInit())
+		if (wc.mode == WindowMode::HEADLESS)
 		{
-			fprintf(stderr, "glfwInit failed\n");
-			return false;
-		}
+			// Without GLFW, which needs a display
+			m_data->m_headlessContext.reset(new HeadlessContext);
+			m_data->m_startTime = std::chrono::steady_clock::now();
 
-		const unsigned int colorBits = std::min(cc.colorBits, 24u);
-		glfwWindowHint(GLFW_RED_BITS, colorBits / 3);
-		glfwWindowHint(GLFW_GREEN_BITS, colorBits / 3);
-		glfwWindowHint(GLFW_BLUE_BITS, colorBits / 3);
-		glfwWindowHint(GLFW_DEPTH_BITS, cc.depthBits);
-		glfwWindowHint(GLFW_STENCIL_BITS, cc.stencilBits);
-		glfwWindowHint(GLFW_SAMPLES, cc.msaaSamples);
-		glfwWindowHint(GLFW_SRGB_CAPABLE, GL_TRUE);
-
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-
-		if (cc.coreProfileContext)
-			glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+			if (!m_data->m_headlessContext->Init(wc.width, wc.height, cc) || !m_data->m_headlessContext->MakeCurrent())
+			{
+				fprintf(stderr, "Creating headless context failed\n");
+				return false;
+			}
+		}
 		else
-			glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
+		{
+			glfwSetErrorCallback(GLFWErrorCallback);
 
-		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, cc.debugContext ? GL_TRUE : GL_FALSE);
-		glfwWindowHint(GLFW_RESIZABLE, wc.resizable ? GL_TRUE : GL_FALSE);
+			if (!glfwInit())
+			{
+				fprintf(stderr, "glfwInit failed\n");
+				return false;
+			}
+
+			const unsigned int colorBits = std::min(cc.colorBits, 24u);
+			glfwWindowHint(GLFW_RED_BITS, colorBits / 3);
+			glfwWindowHint(GLFW_GREEN_BITS, colorBits / 3);
+			glfwWindowHint(GLFW_BLUE_BITS, colorBits / 3);
+			glfwWindowHint(GLFW_DEPTH_BITS, cc.depthBits);
+			glfwWindowHint(GLFW_STENCIL_BITS, cc.stencilBits);
+			glfwWindowHint(GLFW_SAMPLES, cc.msaaSamples);
+			glfwWindowHint(GLFW_SRGB_CAPABLE, GL_TRUE);
+
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+
+			if (cc.coreProfileContext)
+				glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+			else
+				glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
+
+			glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, cc.debugContext ? GL_TRUE : GL_FALSE);
+			glfwWindowHint(GLFW_RESIZABLE, wc.resizable ? GL_TRUE : GL_FALSE);
 		
-		GLFWmonitor* monitor = NULL;
+			GLFWmonitor* monitor = NULL;
 
-		if (wc.mode == WindowMode::FULLSCREEN)
-			monitor = glfwGetPrimaryMonitor();
+			if (wc.mode == WindowMode::FULLSCREEN)
+				monitor = glfwGetPrimaryMonitor();
 
-		m_data->m_windowHandle = glfwCreateWindow(wc.width, wc.height, wc.title.c_str(), monitor, NULL);
+			m_data->m_windowHandle = glfwCreateWindow(wc.width, wc.height, wc.title.c_str(), monitor, NULL);
 
-		if (!m_data->m_windowHandle)
-		{
-			fprintf(stderr, "glfwCreateWindow failed\n");
-			return false;
+			if (!m_data->m_windowHandle)
+			{
+				fprintf(stderr, "glfwCreateWindow failed\n");
+				return false;
+			}
+
+			glfwMakeContextCurrent(m_data->m_windowHandle);
 		}
 
-		glfwMakeContextCurrent(m_data->m_windowHandle);
+		SetGLCallStatisticsEnabled(cc.glCallStatistics);
 
 		if (cc.glewExperimental)
 			glewExperimental = GL_TRUE;
 
-		if (glewInit() != GLEW_OK)
+		// glewInit also loads GLX-extensions, which requires an X-display
+		GLenum glewResult = m_data->m_headlessContext ? glewContextInit() : glewInit();
+		if (glewResult != GLEW_OK)
 		{
 			fprintf(stderr, "glfwInit failed\n");
 			return false;
@@ -148,12 +300,34 @@ namespace Graphics
 #endif
 		}
 
+		// Drivers may expose ARB_get_program_binary without supporting any format
+		GLint numBinaryFormats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numBinaryFormats);
+		ProgramBinaryCache::SetDirectory(numBinaryFormats > 0 ? cc.programBinaryCacheDir : "");
+
+		if (!cc.shaderArchive.empty() && !ShaderArchive::Load(cc.shaderArchive, cc.shaderDevelopmentMode))
+			printf("No shader-archive (%s), using loose files\n", cc.shaderArchive.c_str());
+
+		if (cc.uploadThread)
+		{
+			m_data->m_uploadThread.reset(new UploadThread);
+			if (!m_data->m_uploadThread->Init(m_data->m_windowHandle, m_data->m_headlessContext.get()))
+			{
+				// Uploads are then streamed by the rendering-context instead
+				fprintf(stderr, "Upload-thread unavailable\n");
+				m_data->m_uploadThread.reset();
+			}
+		}
+
 #if TE_MULTI_THREADED
 		// Context is moved to rendering thread
-		glfwMakeContextCurrent(NULL);
-		m_data->m_renderingThread.Init(m_data->m_windowHandle);
+		if (m_data->m_headlessContext)
+			m_data->m_headlessContext->ReleaseCurrent();
+		else
+			glfwMakeContextCurrent(NULL);
+		m_data->m_renderingThread.Init(m_data->m_windowHandle, m_data->m_headlessContext.get(), m_data->m_uploadThread.get());
 #else
-		m_data->m_renderingContext.Init();
+		m_data->m_renderingContext.Init(m_data->m_uploadThread.get());
 		printf("-----MAIN_THREAD-----\n");
 		printf("OpenGL %s\n", glGetString(GL_VERSION));
 		printf("GLSL %s\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
@@ -171,38 +345,92 @@ namespace Graphics
 
 #if TE_MULTI_THREADED
 		m_data->m_renderingThread.Shutdown();
-		glfwMakeContextCurrent(m_data->m_windowHandle);
+		if (m_data->m_headlessContext)
+			m_data->m_headlessContext->MakeCurrent();
+		else
+			glfwMakeContextCurrent(m_data->m_windowHandle);
 #endif
 
-		glfwDestroyWindow(m_data->m_windowHandle);
+		if (m_data->m_uploadThread)
+			m_data->m_uploadThread->Shutdown();
+
+		for (auto& upload : m_data->m_streamedUploads)
+			free(upload.rows);
+		m_data->m_streamedUploads.clear();
+
+		if (m_data->m_headlessContext)
+			m_data->m_headlessContext->Destroy();
+		else
+			glfwDestroyWindow(m_data->m_windowHandle);
 		m_data.reset();
 	}
 
 	bool RenderingSystem::CloseRequested()
 	{
+		if (!m_data->m_windowHandle)
+			return false;
+
 		return glfwWindowShouldClose(m_data->m_windowHandle) == 1;
 	}
 
 	void RenderingSystem::SubmitFrame()
 	{
 		auto& toExecute = m_data->GetCurrentCommandBuffer();
+		m_data->FlushUploadRows(toExecute);
 		toExecute.finish();
 
 #if TE_MULTI_THREADED
 		m_data->m_renderingThread.WaitAndExecute(&toExecute);
 #else
 		m_data->m_renderingContext.ExecuteCommandBuffer(&toExecute);
-		glfwSwapBuffers(m_data->m_windowHandle);
+		if (m_data->m_headlessContext)
+			m_data->m_headlessContext->SwapBuffers();
+		else
+			glfwSwapBuffers(m_data->m_windowHandle);
+#if TE_GL_CALL_STATS
+		GLCallStats::EndFrame();
+#endif
 #endif
 
 		// Swap working buffer
 		m_data->m_currentCommandBuffer = 1 - m_data->m_currentCommandBuffer;
-		m_data->GetCurrentCommandBuffer().start();
+		auto& next = m_data->GetCurrentCommandBuffer();
+
+		// The rendering-thread is done with this buffer, so collect its query-results before reuse
+		for (const auto& queryResult : next.m_queryResults)
+		{
+			auto& state = m_data->m_queryResults[queryResult.handle.handle];
+			state.available = true;
+			state.frame = queryResult.frame;
+			state.result = queryResult.result;
+		}
+
+		for (const auto& readback : next.m_readbacks)
+		{
+			auto it = m_data->m_readbackCallbacks.find(readback.id);
+			assert(it != m_data->m_readbackCallbacks.end());
+
+			it->second(readback.data, readback.size);
+			free(readback.data);
+
+			m_data->m_readbackCallbacks.erase(it);
+		}
+
+		m_data->m_uploadAreas.insert(m_data->m_uploadAreas.end(), next.m_uploadAreas.begin(), next.m_uploadAreas.end());
+
+		next.start();
+		++m_data->m_frameNumber;
+	}
+
+	uint32_t RenderingSystem::GetFrameNumber()
+	{
+		return m_data->m_frameNumber;
 	}
 
 	void RenderingSystem::PollEvents()
 	{
-		glfwPollEvents();
+		if (m_data->m_windowHandle)
+			glfwPollEvents();
 
 		// Update input-state
 		memcpy(m_data->m_oldKeyState, m_data->m_keyState, sizeof(m_data->m_keyState));
@@ -215,11 +443,17 @@ namespace Graphics
 
 	double RenderingSystem::GetTime()
 	{
+		if (m_data->m_headlessContext)
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_data->m_startTime).count();
+
 		return glfwGetTime();
 	}
 
 	glm::vec2 RenderingSystem::GetCursorPosition()
 	{
+		if (!m_data->m_windowHandle)
+			return glm::vec2(0, 0);
+
 		double x, y;
 		glfwGetCursorPos(m_data->m_windowHandle, &x, &y);
 		return glm::vec2(x, y);
@@ -227,17 +461,43 @@ namespace Graphics
 
 	bool RenderingSystem::IsKeyDown(Key k)
 	{
+		if (!m_data->m_windowHandle)
+			return false;
+
 		return glfwGetKey(m_data->m_windowHandle, toGLFW(k)) == GLFW_PRESS;
 	}
 
 	bool RenderingSystem::IsMouseButtonDown(MouseButton key)
 	{
+		if (!m_data->m_windowHandle)
+			return false;
+
 		return glfwGetMouseButton(m_data->m_windowHandle, key == MouseButton::Right ? GLFW_MOUSE_BUTTON_RIGHT : GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
 	}
 
 	void RenderingSystem::SetWindowTitle(const std::string& title)
 	{
-		glfwSetWindowTitle(m_data->m_windowHandle, title.c_str());
+		if (m_data->m_windowHandle)
+			glfwSetWindowTitle(m_data->m_windowHandle, title.c_str());
+	}
+
+	void RenderingSystem::SetGLCallStatisticsEnabled(bool enabled)
+	{
+#if TE_GL_CALL_STATS
+		GLCallStats::SetEnabled(enabled);
+#else
+		if (enabled)
+			fprintf(stderr, "GL-call statistics not compiled in (TE_GL_CALL_STATS)\n");
+#endif
+	}
+
+	bool RenderingSystem::IsGLCallStatisticsEnabled()
+	{
+#if TE_GL_CALL_STATS
+		return GLCallStats::IsEnabled();
+#else
+		return false;
+#endif
 	}
 
 	bool RenderingSystem::WasPressed(Key key)
@@ -286,6 +546,21 @@ namespace Graphics
 
 	void RenderingSystem::UpdateBuffer(BufferHandle buffer, void* bufferData, uint32_t size, BufferType usage)
 	{
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+
+		if (usage == BufferType::STATIC && bufferData && size)
+		{
+			// Packed into the frame's staging-area instead of a separate malloc and upload
+			UpdateBufferStagedData data;
+			data.buffer = buffer;
+			data.offset = cmdBuff.stage(bufferData, size);
+			data.size = size;
+
+			cmdBuff.write(CommandBuffer::Command::UpdateBufferStaged);
+			cmdBuff.write(data);
+			return;
+		}
+
 		void* dataCopy = nullptr;
 
 		if (bufferData && size)
@@ -302,7 +577,6 @@ namespace Graphics
 		data.size = size;
 		data.usage = usage;
 
-		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
 		cmdBuff.write(CommandBuffer::Command::UpdateBuffer);
 		cmdBuff.write(data);
 	}
@@ -324,8 +598,13 @@ namespace Graphics
 	void RenderingSystem::UpdateTexture2D(Texture2DHandle buffer, void* textureData, uint16_t width, uint16_t height, TextureType type)
 	{
 		void* dataCopy = nullptr;
+		const bool streamed = textureData && !m_data->m_uploadThread;
 
-		if (textureData)
+		if (streamed)
+		{
+			m_data->StreamRows(textureData, width * 4u, height);
+		}
+		else if (textureData)
 		{
 			size_t size = width * height * 4;
 			// TODO Allocator for frame instead of individual mallocs
@@ -340,15 +619,88 @@ namespace Graphics
 		data.height = height;
 		data.width = width;
 		data.type = type;
+		data.streamed = streamed;
 
 		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
 		cmdBuff.write(CommandBuffer::Command::UploadTexture2D);
 		cmdBuff.write(data);
 	}
 
+	Texture2DArrayHandle RenderingSystem::CreateTexture2DArray()
+	{
+		assert(m_data->m_numTexture2DArrays < std::numeric_limits<decltype(m_data->m_numTexture2DArrays)>::max());
+
+		CreateTexture2DArrayData data;
+		data.handle = { ++m_data->m_numTexture2DArrays };
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::CreateTexture2DArray);
+		cmdBuff.write(data);
+
+		return data.handle;
+	}
+
+	void RenderingSystem::AllocateTexture2DArray(Texture2DArrayHandle handle, uint16_t width, uint16_t height, uint16_t layers, TextureType type)
+	{
+		AllocateTexture2DArrayData data;
+		data.handle = handle;
+		data.width = width;
+		data.height = height;
+		data.layers = layers;
+		data.type = type;
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::AllocateTexture2DArray);
+		cmdBuff.write(data);
+	}
+
+	void RenderingSystem::UpdateTexture2DArrayLayer(Texture2DArrayHandle handle, uint16_t layer, void* textureData, uint16_t width, uint16_t height)
+	{
+		assert(textureData);
+
+		const bool streamed = !m_data->m_uploadThread;
+		void* dataCopy = nullptr;
+
+		if (streamed)
+		{
+			m_data->StreamRows(textureData, width * 4u, height);
+		}
+		else
+		{
+			size_t size = width * height * 4;
+			dataCopy = malloc(size);
+			assert(dataCopy && "dataCopy UpdateTexture2DArrayLayer");
+			memcpy(dataCopy, textureData, size);
+		}
+
+		UploadTexture2DArrayLayerData data;
+		data.handle = handle;
+		data.data = dataCopy;
+		data.width = width;
+		data.height = height;
+		data.layer = layer;
+		data.streamed = streamed;
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::UploadTexture2DArrayLayer);
+		cmdBuff.write(data);
+	}
+
+	void RenderingSystem::BindTexture2DArray(uint8_t unit, Texture2DArrayHandle texture)
+	{
+		BindTexture2DArrayData data;
+		data.texture = texture;
+		data.unit = unit;
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::BindTexture2DArray);
+		cmdBuff.write(data);
+	}
+
 	void RenderingSystem::SetCursorEnabled(bool enabled)
 	{
-		glfwSetInputMode(m_data->m_windowHandle, GLFW_CURSOR, enabled ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
+		if (m_data->m_windowHandle)
+			glfwSetInputMode(m_data->m_windowHandle, GLFW_CURSOR, enabled ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
 	}
 
 	void RenderingSystem::BindTexture2D(uint8_t unit, Texture2DHandle texture)
@@ -384,6 +736,26 @@ namespace Graphics
 		cmdBuff.write(data);
 	}
 
+	void RenderingSystem::SetWriteMask(const ColorMask& colorMask, bool depthMask)
+	{
+		m_data->m_colorMask = colorMask;
+		m_data->m_depthMask = depthMask;
+
+		SetWriteMaskData data;
+		data.colorMask = colorMask;
+		data.depthMask = depthMask;
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::SetWriteMask);
+		cmdBuff.write(data);
+	}
+
+	void RenderingSystem::GetWriteMask(ColorMask& outColorMask, bool& outDepthMask)
+	{
+		outColorMask = m_data->m_colorMask;
+		outDepthMask = m_data->m_depthMask;
+	}
+
 	void RenderingSystem::BindUniformBuffer(uint8_t bindingIndex, BufferHandle buffer)
 	{
 		BindUniformBufferData data;
@@ -395,12 +767,190 @@ namespace Graphics
 		cmdBuff.write(data);
 	}
 
+	void RenderingSystem::BindStorageBuffer(uint8_t bindingIndex, BufferHandle buffer)
+	{
+		BindStorageBufferData data;
+		data.bindingIndex = bindingIndex;
+		data.buffer = buffer;
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::BindStorageBuffer);
+		cmdBuff.write(data);
+	}
+
+	void RenderingSystem::BindImage(uint8_t unit, Texture2DHandle texture, ImageAccess access, TextureType format)
+	{
+		BindImageData data;
+		data.unit = unit;
+		data.texture = texture;
+		data.access = access;
+		data.format = format;
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::BindImage);
+		cmdBuff.write(data);
+	}
+
+	void RenderingSystem::BindRenderTargetImage(uint8_t unit, RenderTargetHandle handle, RenderTargetTexture texture, ImageAccess access, TextureType format)
+	{
+		BindRenderTargetImageData data;
+		data.unit = unit;
+		data.handle = handle;
+		data.texture = texture;
+		data.access = access;
+		data.format = format;
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::BindRenderTargetImage);
+		cmdBuff.write(data);
+	}
+
+	void RenderingSystem::Dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ)
+	{
+		DispatchData data;
+		data.groupsX = groupsX;
+		data.groupsY = groupsY;
+		data.groupsZ = groupsZ;
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::Dispatch);
+		cmdBuff.write(data);
+	}
+
+	void RenderingSystem::MemoryBarrier(uint32_t barriers)
+	{
+		MemoryBarrierData data;
+		data.barriers = barriers;
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::MemoryBarrier);
+		cmdBuff.write(data);
+	}
+
 	void RenderingSystem::ReloadShaders()
 	{
 		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
 		cmdBuff.write(CommandBuffer::Command::ReloadShaders);
 	}
 
+	void RenderingSystem::ExpectBinding(BindingType type, const std::string& name, uint16_t index)
+	{
+		ExpectBindingData data;
+		data.namePtr = new std::string(name);
+		data.type = type;
+		data.index = index;
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::ExpectBinding);
+		cmdBuff.write(data);
+	}
+
+	QueryHandle RenderingSystem::CreateQuery(QueryType type)
+	{
+		assert(m_data->m_numQueries < std::numeric_limits<decltype(m_data->m_numQueries)>::max());
+
+		CreateQueryData data;
+		data.handle = { ++m_data->m_numQueries };
+		data.type = type;
+
+		m_data->m_queryResults.resize(m_data->m_numQueries + 1u);
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::CreateQuery);
+		cmdBuff.write(data);
+
+		return data.handle;
+	}
+
+	void RenderingSystem::BeginQuery(QueryHandle handle)
+	{
+		BeginQueryData data;
+		data.handle = handle;
+		data.frame = m_data->m_frameNumber;
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::BeginQuery);
+		cmdBuff.write(data);
+	}
+
+	void RenderingSystem::EndQuery(QueryHandle handle)
+	{
+		EndQueryData data;
+		data.handle = handle;
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::EndQuery);
+		cmdBuff.write(data);
+	}
+
+	void RenderingSystem::BeginConditionalRender(QueryHandle handle)
+	{
+		BeginConditionalRenderData data;
+		data.handle = handle;
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::BeginConditionalRender);
+		cmdBuff.write(data);
+	}
+
+	void RenderingSystem::EndConditionalRender()
+	{
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::EndConditionalRender);
+	}
+
+	bool RenderingSystem::GetQueryResult(QueryHandle handle, uint64_t& outResult, uint32_t* outFrameIssued)
+	{
+		assert(handle.IsValid() && handle.handle < m_data->m_queryResults.size());
+
+		const auto& state = m_data->m_queryResults[handle.handle];
+		if (!state.available)
+			return false;
+
+		outResult = state.result;
+		if (outFrameIssued)
+			*outFrameIssued = state.frame;
+
+		return true;
+	}
+
+	void RenderingSystem::ReadRenderTarget(RenderTargetHandle handle, RenderTargetTexture texture, uint16_t x, uint16_t y, uint16_t width, uint16_t height, ReadbackCallback callback)
+	{
+		assert(handle.IsValid() || texture == RenderTargetTexture::Color);
+
+		ReadRenderTargetData data;
+		data.id = ++m_data->m_readbackId;
+		data.handle = handle;
+		data.texture = texture;
+		data.x = x;
+		data.y = y;
+		data.width = width;
+		data.height = height;
+
+		m_data->m_readbackCallbacks[data.id] = std::move(callback);
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::ReadRenderTarget);
+		cmdBuff.write(data);
+	}
+
+	void RenderingSystem::ReadBuffer(BufferHandle buffer, uint32_t offset, uint32_t size, ReadbackCallback callback)
+	{
+		assert(buffer.IsValid());
+
+		ReadBufferData data;
+		data.id = ++m_data->m_readbackId;
+		data.buffer = buffer;
+		data.offset = offset;
+		data.size = size;
+
+		m_data->m_readbackCallbacks[data.id] = std::move(callback);
+
+		auto& cmdBuff = m_data->GetCurrentCommandBuffer();
+		cmdBuff.write(CommandBuffer::Command::ReadBuffer);
+		cmdBuff.write(data);
+	}
+
 	RenderTargetHandle RenderingSystem::CreateRenderTarget(RenderTargetOptions options)
 	{
 		assert(m_data->m_numRenderTargets < std::numeric_limits<decltype(m_data->m_numRenderTargets)>::max());
@@ -2,12 +2,15 @@
 
 #include <memory>
 #include <string>
+#include <functional>
 
 #include "RenderState.h"
 #include "ShaderInfo.h"
 #include "Handles.h"
 #include "EnumsFlags.h"
 
+#undef MemoryBarrier // windows.h
+
 namespace Graphics
 {
 	struct ContextConfig
@@ -21,11 +24,21 @@ namespace Graphics
 		bool coreProfileContext = true;
 		bool synchronousDebugOutput = false;
 		bool glewExperimental = true;
+		bool glCallStatistics = false; // Prints per-frame GL-call counts/timings (see GLCallStats.h)
+		bool uploadThread = true; // Upload texture-data on a separate thread and shared context (see UploadThread.h)
+		std::string programBinaryCacheDir = "shadercache"; // Linked programs are cached here, empty disables (see ProgramBinaryCache.h)
+		std::string shaderArchive = "shaders.pak"; // Preprocessed shaders; loose files are used if missing (see ShaderArchive.h)
+#ifdef _DEBUG
+		bool shaderDevelopmentMode = true; // Archived shaders whose loose files have changed are ignored
+#else
+		bool shaderDevelopmentMode = false;
+#endif
 	};
 
 	enum class WindowMode
 	{
-		WINDOW, FULLSCREEN
+		WINDOW, FULLSCREEN, 
+		HEADLESS // No window or input; renders offscreen (see HeadlessContext.h)
 	};
 
 	struct WindowConfig
@@ -57,7 +70,10 @@ namespace Graphics
 
 		void SetWindowTitle(const std::string& title);
 
-		enum class Key { SPACE, ESCAPE, W, A, S, D, Q, E, SHIFT, F1, F2, F3, LAST_KEY /* to track enum legth */ };
+		void SetGLCallStatisticsEnabled(bool enabled);
+		bool IsGLCallStatisticsEnabled();
+
+		enum class Key { SPACE, ESCAPE, W, A, S, D, Q, E, SHIFT, F1, F2, F3, F4, F5, F6, F7, LAST_KEY /* to track enum legth */ };
 		bool IsKeyDown(Key key);
 		bool WasPressed(Key key);
 
@@ -74,7 +90,10 @@ namespace Graphics
 
 		// Shaderprograms
 		ShaderProgramHandle CreateShaderProgram(const Graphics::ShaderInfo& si);
-		void ReloadShaders();
+		void ReloadShaders(); // Changed programs are reloaded automatically; this reloads all
+
+		// Every program using a resource called 'name' is checked to bind it at 'index' when loaded
+		void ExpectBinding(BindingType type, const std::string& name, uint16_t index);
 		void UseShaderProgram(ShaderProgramHandle handle);
 
 		// Buffers
@@ -84,9 +103,16 @@ namespace Graphics
 
 		// Textures
 		Texture2DHandle CreateTexture2D();
+		// Data is copied. Without the upload-thread, rows go straight into upload-PBOs while they have room.
 		void UpdateTexture2D(Texture2DHandle buffer, void* data, uint16_t width, uint16_t height, TextureType flags);
 		void BindTexture2D(uint8_t unit, Texture2DHandle buffer);
 
+		// Texture arrays (all layers share size and type; data is RGBA8 like UpdateTexture2D)
+		Texture2DArrayHandle CreateTexture2DArray();
+		void AllocateTexture2DArray(Texture2DArrayHandle handle, uint16_t width, uint16_t height, uint16_t layers, TextureType type);
+		void UpdateTexture2DArrayLayer(Texture2DArrayHandle handle, uint16_t layer, void* data, uint16_t width, uint16_t height);
+		void BindTexture2DArray(uint8_t unit, Texture2DArrayHandle handle);
+
 		// Rendertargets
 		RenderTargetHandle CreateRenderTarget(RenderTargetOptions textures);
 		void BindRenderTarget(RenderTargetHandle handle);
@@ -94,10 +120,45 @@ namespace Graphics
 
 		// Drawing
 		void Draw(BufferHandle vertexBuffer, BufferHandle indexBuffer, uint32_t elements);
+		void SetWriteMask(const ColorMask& colorMask, bool depthMask);
+		void GetWriteMask(ColorMask& outColorMask, bool& outDepthMask); // As last set for this frame
+
+		// Compute
+		void BindStorageBuffer(uint8_t bindingIndex, BufferHandle buffer);
+		void BindImage(uint8_t unit, Texture2DHandle texture, ImageAccess access, TextureType format);
+		void BindRenderTargetImage(uint8_t unit, RenderTargetHandle handle, RenderTargetTexture texture, ImageAccess access, TextureType format);
+		void Dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ);
+		void MemoryBarrier(uint32_t barriers); // MemoryBarrierBits
+
+		// Queries. Only one query per type can be active at a time, and SamplesPassed and AnySamplesPassed
+		// share a target, so they can't be active together either. Results are delivered asynchronously 
+		// (typically a few frames after the query was issued); GetQueryResult never waits for the GPU, 
+		// and returns false until a first result is available. 
+		QueryHandle CreateQuery(QueryType type);
+		void BeginQuery(QueryHandle handle);
+		void EndQuery(QueryHandle handle);
+		bool GetQueryResult(QueryHandle handle, uint64_t& outResult, uint32_t* outFrameIssued = nullptr);
+
+		// Draws between these are skipped on the GPU if the last finished Begin/EndQuery-pair of the 
+		// (SamplesPassed/AnySamplesPassed) query had no samples pass. Draws unconditionally if the query 
+		// hasn't been issued yet, or its result isn't available (never waits).
+		void BeginConditionalRender(QueryHandle handle);
+		void EndConditionalRender();
+
+		// Readbacks. Data is copied to a pixel-pack buffer on the GPU and handed to the callback (on the 
+		// frontend, during a later SubmitFrame) once it is ready; the pointer is only valid during the call. 
+		// Color/Aux is read as RGBA8, Depth as 32-bit float, rows bottom to top. The default rendertarget only has Color.
+		// Data is NULL if the readback failed.
+		typedef std::function<void(const void* data, uint32_t size)> ReadbackCallback;
+		void ReadRenderTarget(RenderTargetHandle handle, RenderTargetTexture texture, uint16_t x, uint16_t y, uint16_t width, uint16_t height, ReadbackCallback callback);
+		void ReadBuffer(BufferHandle buffer, uint32_t offset, uint32_t size, ReadbackCallback callback);
 
 		// Submit current frame for rendering
 		void SubmitFrame();
 
+		// Number of frames submitted
+		uint32_t GetFrameNumber();
+
 	private:
 		struct RenderingSystem_data;
 		std::unique_ptr<RenderingSystem_data> m_data;
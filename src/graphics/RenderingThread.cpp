@@ -3,6 +3,7 @@
 #include "OpenGL.h"
 #include "CommandBuffer.h"
 #include "Context.h"
+#include "HeadlessContext.h"
 
 #include <iostream>
 #include <cstring> // memcpy
@@ -20,19 +21,21 @@ namespace Graphics
 		Shutdown();
 	}
 
-	bool RenderingThread::Init(GLFWwindow* window)
+	bool RenderingThread::Init(GLFWwindow* window, HeadlessContext* headlessContext, UploadThread* uploadThread)
 	{
 		m_shouldExit = false;
 		m_windowHandle = window;
+		m_headlessContext = headlessContext;
+		m_uploadThread = uploadThread;
 
 		m_thread = std::thread([this]
 		{
 			// Take context
-			glfwMakeContextCurrent(m_windowHandle);
+			MakeContextCurrent(true);
 
 			{
 				std::unique_ptr<Graphics::Context> renderingContext(new Graphics::Context);
-				renderingContext->Init();
+				renderingContext->Init(m_uploadThread);
 
 				printf("---RENDERING_THREAD---\n");
 				printf("OpenGL %s\n", glGetString(GL_VERSION));
@@ -51,8 +54,12 @@ namespace Graphics
 					if (m_commandBuffer)
 					{
 						renderingContext->ExecuteCommandBuffer(m_commandBuffer);
-						glfwSwapBuffers(m_windowHandle);
+						SwapBuffers();
 						m_commandBuffer = nullptr;
+
+#if TE_GL_CALL_STATS
+						GLCallStats::EndFrame();
+#endif
 					}
 
 					m_threadIsReady.notify();
@@ -60,12 +67,35 @@ namespace Graphics
 			}
 
 			// Release context when exiting
-			glfwMakeContextCurrent(NULL);
+			MakeContextCurrent(false);
 		});
 
 		return true;
 	}
 
+	void RenderingThread::MakeContextCurrent(bool current)
+	{
+		if (m_headlessContext)
+		{
+			if (current)
+				m_headlessContext->MakeCurrent();
+			else
+				m_headlessContext->ReleaseCurrent();
+		}
+		else
+		{
+			glfwMakeContextCurrent(current ? m_windowHandle : NULL);
+		}
+	}
+
+	void RenderingThread::SwapBuffers()
+	{
+		if (m_headlessContext)
+			m_headlessContext->SwapBuffers();
+		else
+			glfwSwapBuffers(m_windowHandle);
+	}
+
 	void RenderingThread::Shutdown()
 	{
 		if (m_shouldExit)
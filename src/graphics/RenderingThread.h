@@ -11,6 +11,8 @@ struct GLFWwindow;
 namespace Graphics
 {
 	struct CommandBuffer;
+	class HeadlessContext;
+	class UploadThread;
 
 	class Semaphore {
 	private:
@@ -45,7 +47,8 @@ namespace Graphics
 		RenderingThread();
 		~RenderingThread();
 
-		bool Init(GLFWwindow* window);
+		// Renders to either the window or the headless context. 'uploadThread' is optional.
+		bool Init(GLFWwindow* window, HeadlessContext* headlessContext, UploadThread* uploadThread);
 		void Shutdown();
 
 		// Waits until current frame is drawn, 
@@ -56,8 +59,13 @@ namespace Graphics
 		Semaphore m_threadStart;
 
 	private:
+		void MakeContextCurrent(bool current);
+		void SwapBuffers();
+
 		CommandBuffer* m_commandBuffer;
 		GLFWwindow* m_windowHandle;
+		HeadlessContext* m_headlessContext;
+		UploadThread* m_uploadThread;
 
 		std::thread m_thread;
 		std::atomic<bool> m_shouldExit;
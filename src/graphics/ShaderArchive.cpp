@@ -0,0 +1,218 @@
+#include "ShaderArchive.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+namespace Graphics
+{
+	namespace ShaderArchive
+	{
+		namespace
+		{
+			const uint32_t MAGIC = 0x41534554; // "TESA"
+			const uint32_t VERSION = 1;
+
+			Entries g_entries;
+
+			// FNV-1a
+			uint64_t Hash(const void* data, size_t size)
+			{
+				uint64_t hash = 14695981039346656037ull;
+				const uint8_t* bytes = static_cast<const uint8_t*>(data);
+				for (size_t i = 0; i < size; ++i)
+				{
+					hash ^= bytes[i];
+					hash *= 1099511628211ull;
+				}
+				return hash;
+			}
+
+			void WriteU32(std::string& out, uint32_t value)
+			{
+				out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+			}
+
+			void WriteU64(std::string& out, uint64_t value)
+			{
+				out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+			}
+
+			void WriteString(std::string& out, const std::string& str)
+			{
+				WriteU32(out, static_cast<uint32_t>(str.size()));
+				out.append(str);
+			}
+
+			// Reads from an in-memory archive; every read is bounds-checked
+			struct Reader
+			{
+				const char* pos;
+				const char* end;
+
+				bool Read(void* out, size_t size)
+				{
+					if (static_cast<size_t>(end - pos) < size)
+						return false;
+
+					memcpy(out, pos, size);
+					pos += size;
+					return true;
+				}
+
+				bool ReadString(std::string& out)
+				{
+					uint32_t length;
+					if (!Read(&length, sizeof(length)) || static_cast<size_t>(end - pos) < length)
+						return false;
+
+					out.assign(pos, length);
+					pos += length;
+					return true;
+				}
+			};
+		}
+
+		bool Write(const std::string& path, const Entries& entries)
+		{
+			std::string out;
+			WriteU32(out, MAGIC);
+			WriteU32(out, VERSION);
+			WriteU32(out, static_cast<uint32_t>(entries.size()));
+
+			for (const auto& entry : entries)
+			{
+				WriteString(out, entry.first);
+				WriteString(out, entry.second.source);
+				WriteU32(out, static_cast<uint32_t>(entry.second.files.size()));
+
+				for (size_t i = 0; i < entry.second.files.size(); ++i)
+				{
+					WriteString(out, entry.second.files[i]);
+					WriteU64(out, entry.second.hashes[i]);
+				}
+			}
+
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			if (!file)
+				return false;
+
+			file.write(out.data(), out.size());
+			return file.good();
+		}
+
+		bool Read(const std::string& path, Entries& out)
+		{
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file)
+				return false;
+
+			// The whole archive in one read
+			std::vector<char> data(static_cast<size_t>(file.tellg()));
+			file.seekg(0, std::ios::beg);
+			if (!file.read(data.data(), data.size()))
+				return false;
+
+			Reader reader = { data.data(), data.data() + data.size() };
+
+			uint32_t magic, version, count;
+			if (!reader.Read(&magic, sizeof(magic)) || !reader.Read(&version, sizeof(version)) || !reader.Read(&count, sizeof(count)) ||
+				magic != MAGIC || version != VERSION)
+			{
+				return false;
+			}
+
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				std::string name;
+				Entry entry;
+				uint32_t numFiles;
+				if (!reader.ReadString(name) || !reader.ReadString(entry.source) || !reader.Read(&numFiles, sizeof(numFiles)))
+					return false;
+
+				for (uint32_t f = 0; f < numFiles; ++f)
+				{
+					std::string dependency;
+					uint64_t hash;
+					if (!reader.ReadString(dependency) || !reader.Read(&hash, sizeof(hash)))
+						return false;
+
+					entry.files.push_back(std::move(dependency));
+					entry.hashes.push_back(hash);
+				}
+
+				out[name] = std::move(entry);
+			}
+
+			return true;
+		}
+
+		bool HashFile(const std::string& file, uint64_t& hash)
+		{
+			std::ifstream in(file, std::ios::binary);
+			if (!in)
+				return false;
+
+			const std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			hash = Hash(contents.data(), contents.size());
+			return true;
+		}
+
+		bool Load(const std::string& path, bool developmentMode)
+		{
+			g_entries.clear();
+
+			if (path.empty() || !Read(path, g_entries))
+			{
+				g_entries.clear();
+				return false;
+			}
+
+			if (developmentMode)
+			{
+				// Loose files that exist win over stale entries; missing ones mean the archive is all there is
+				for (auto it = g_entries.begin(); it != g_entries.end(); )
+				{
+					bool stale = false;
+					for (size_t i = 0; i < it->second.files.size() && !stale; ++i)
+					{
+						uint64_t hash;
+						stale = HashFile(it->second.files[i], hash) && hash != it->second.hashes[i];
+					}
+
+					if (stale)
+						it = g_entries.erase(it);
+					else
+						++it;
+				}
+			}
+
+			return true;
+		}
+
+		void Unload()
+		{
+			g_entries.clear();
+		}
+
+		const Entry* Find(const std::string& file)
+		{
+			const auto& f = g_entries.find(file);
+			return f != g_entries.end() ? &f->second : nullptr;
+		}
+
+		void Invalidate(const std::string& file)
+		{
+			for (auto it = g_entries.begin(); it != g_entries.end(); )
+			{
+				const std::vector<std::string>& files = it->second.files;
+				if (std::find(files.begin(), files.end(), file) != files.end())
+					it = g_entries.erase(it);
+				else
+					++it;
+			}
+		}
+	}
+}
\ No newline at end of file
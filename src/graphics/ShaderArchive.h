@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+namespace Graphics
+{
+	// All shaders preprocessed into one file, built by tools/ShaderPack.cpp (the ShaderArchive-target),
+	// and read with a single read at startup. ShaderPreprocessor uses an entry instead of the loose files
+	// while it's valid; entries are dropped when any file they depend on changes (see Invalidate), and
+	// in development-mode also when a loose file's hash differs from the one it was built from.
+	namespace ShaderArchive
+	{
+		struct Entry
+		{
+			std::string source; // As ShaderPreprocessor::Process returns it, without defines
+			std::vector<std::string> files;
+			std::vector<uint64_t> hashes; // Of the files' contents
+		};
+
+		typedef std::unordered_map<std::string, Entry> Entries;
+
+		bool Write(const std::string& path, const Entries& entries);
+		bool Read(const std::string& path, Entries& out);
+
+		// Returns false if 'file' can't be read
+		bool HashFile(const std::string& file, uint64_t& hash);
+
+		// For ShaderPreprocessor; only used from the rendering-thread after Load
+		bool Load(const std::string& path, bool developmentMode);
+		void Unload();
+		const Entry* Find(const std::string& file);
+		void Invalidate(const std::string& file);
+	}
+}
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <functional>
 
 namespace Graphics
 {
@@ -23,6 +25,14 @@ namespace Graphics
 			return si;
 		}
 
+		static ShaderInfo CS(const std::string& cs, const std::string& includeDir)
+		{
+			ShaderInfo si;
+			si.setComputeShaderFile(cs);
+			si.setLookForIncludesDir(includeDir);
+			return si;
+		}
+
 		void setVertexShaderFile(const std::string& str)
 		{
 			vsFile = str;
@@ -48,14 +58,28 @@ namespace Graphics
 			gsFile = str;
 		}
 
+		// Compute shaders can't be combined with other stages
+		void setComputeShaderFile(const std::string& str)
+		{
+			csFile = str;
+		}
+
 		void setLookForIncludesDir(const std::string& str)
 		{
 			includeDir = str;
 		}
 
+		// Inserted as '#define <name> 1' after the '#version'-line of every stage
+		void addDefine(const std::string& name)
+		{
+			defines.push_back(name);
+		}
+
 		size_t GetHash() const
 		{
-			std::string str = vsFile + fsFile + tcFile + teFile + gsFile;
+			std::string str = vsFile + fsFile + tcFile + teFile + gsFile + csFile;
+			for (const std::string& define : defines)
+				str += "|" + define;
 			return std::hash<std::string>()(str);
 		}
 
@@ -64,6 +88,8 @@ namespace Graphics
 		std::string teFile{ "" };
 		std::string gsFile{ "" };
 		std::string fsFile{ "" };
+		std::string csFile{ "" };
 		std::string includeDir{ "" };
+		std::vector<std::string> defines;
 	};
 }
\ No newline at end of file
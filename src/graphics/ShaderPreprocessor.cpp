@@ -0,0 +1,273 @@
+#include "ShaderPreprocessor.h"
+#include "ShaderArchive.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <stdint.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace Graphics
+{
+	namespace ShaderPreprocessor
+	{
+		namespace
+		{
+			// A file split at its includes
+			struct ParsedFile
+			{
+				struct Chunk
+				{
+					std::string text; // Lines before the include, newline-terminated
+					std::string include; // Empty for the last chunk
+					int includeLine; // 1-based line of the include-directive
+				};
+
+				int64_t mtime = 0;
+				bool pragmaOnce = false;
+				std::vector<Chunk> chunks;
+			};
+
+			std::unordered_map<std::string, ParsedFile> g_files;
+
+			bool GetModificationTime(const std::string& file, int64_t& mtime)
+			{
+				struct stat st;
+				if (stat(file.c_str(), &st) != 0)
+					return false;
+
+				mtime = static_cast<int64_t>(st.st_mtime);
+				return true;
+			}
+
+			std::string Trim(const std::string& str)
+			{
+				const size_t first = str.find_first_not_of(" \t\r");
+				if (first == std::string::npos)
+					return "";
+
+				const size_t last = str.find_last_not_of(" \t\r");
+				return str.substr(first, last - first + 1);
+			}
+
+			// Returns the included file-name, or an empty string if 'line' isn't an include
+			std::string ParseInclude(const std::string& line)
+			{
+				const std::string trimmed = Trim(line);
+
+				// '@file // comment'
+				if (trimmed.length() > 1 && trimmed[0] == '@')
+					return trimmed.substr(1, trimmed.find_first_of(" \t") - 1);
+
+				// '#include "file"' or '#include <file>'
+				if (trimmed.compare(0, 8, "#include") == 0)
+				{
+					const size_t begin = trimmed.find_first_of("\"<", 8);
+					if (begin != std::string::npos)
+					{
+						const size_t end = trimmed.find_first_of("\">", begin + 1);
+						if (end != std::string::npos)
+							return trimmed.substr(begin + 1, end - begin - 1);
+					}
+				}
+
+				return "";
+			}
+
+			bool IsPragmaOnce(const std::string& line)
+			{
+				std::string trimmed = Trim(line);
+				trimmed.erase(std::remove_if(trimmed.begin(), trimmed.end(), [](char c) { return c == ' ' || c == '\t'; }), trimmed.end());
+				return trimmed == "#pragmaonce";
+			}
+
+			const ParsedFile* GetFile(const std::string& file)
+			{
+				int64_t mtime;
+				if (!GetModificationTime(file, mtime))
+					return nullptr;
+
+				const auto& f = g_files.find(file);
+				if (f != g_files.end() && f->second.mtime == mtime)
+					return &f->second;
+
+				std::ifstream in(file);
+				if (!in.is_open())
+					return nullptr;
+
+				ParsedFile parsed;
+				parsed.mtime = mtime;
+
+				ParsedFile::Chunk chunk;
+				chunk.includeLine = 0;
+
+				std::string line;
+				int lineNumber = 0;
+				while (std::getline(in, line))
+				{
+					++lineNumber;
+
+					const std::string include = ParseInclude(line);
+					if (!include.empty())
+					{
+						chunk.include = include;
+						chunk.includeLine = lineNumber;
+						parsed.chunks.push_back(chunk);
+
+						chunk = ParsedFile::Chunk();
+						chunk.includeLine = 0;
+						continue;
+					}
+
+					if (IsPragmaOnce(line))
+					{
+						// Keep line-numbers intact
+						parsed.pragmaOnce = true;
+						chunk.text += "\n";
+						continue;
+					}
+
+					chunk.text += line;
+					chunk.text += "\n";
+				}
+				parsed.chunks.push_back(chunk);
+
+				ParsedFile& cached = g_files[file];
+				cached = std::move(parsed);
+				return &cached;
+			}
+
+			struct State
+			{
+				const std::string& includeDir;
+				Result& result;
+				std::stringstream out;
+				std::vector<std::string> stack; // For detecting cycles
+				std::unordered_set<std::string> once;
+			};
+
+			int GetFileIndex(Result& result, const std::string& file)
+			{
+				const auto& f = std::find(result.files.begin(), result.files.end(), file);
+				if (f != result.files.end())
+					return static_cast<int>(f - result.files.begin());
+
+				result.files.push_back(file);
+				return static_cast<int>(result.files.size() - 1);
+			}
+
+			bool Expand(State& state, const std::string& file, const std::string& includedFrom)
+			{
+				if (std::find(state.stack.begin(), state.stack.end(), file) != state.stack.end())
+				{
+					std::cerr << "Recursive include of '" << file << "' in " << includedFrom << std::endl;
+					return false;
+				}
+
+				if (state.once.count(file))
+					return true;
+
+				const ParsedFile* parsed = GetFile(file);
+				if (!parsed)
+				{
+					if (includedFrom.empty())
+						std::cerr << "Couldn't load source from file " << file << std::endl;
+					else
+						std::cerr << "Couldn't include file '" << file << "' while parsing " << includedFrom << std::endl;
+					return false;
+				}
+
+				if (parsed->pragmaOnce)
+					state.once.insert(file);
+
+				const int index = GetFileIndex(state.result, file);
+				const bool isRoot = includedFrom.empty();
+
+				// '#line' may not precede '#version', so the root file starts without one
+				if (!isRoot)
+					state.out << "#line 1 " << index << "\n";
+
+				state.stack.push_back(file);
+
+				bool success = true;
+				for (const ParsedFile::Chunk& chunk : parsed->chunks)
+				{
+					state.out << chunk.text;
+
+					if (chunk.include.empty())
+						continue;
+
+					// Failed includes are reported but don't stop expansion, so all missing files are listed
+					success &= Expand(state, state.includeDir + chunk.include, file);
+
+					// Back in this file, on the line after the include
+					state.out << "#line " << chunk.includeLine + 1 << " " << index << "\n";
+				}
+
+				state.stack.pop_back();
+				return success;
+			}
+		}
+
+		Result Process(const std::string& file, const std::string& includeDir, const std::vector<std::string>& defines)
+		{
+			Result result;
+
+			if (const ShaderArchive::Entry* entry = ShaderArchive::Find(file))
+			{
+				result.source = entry->source;
+				result.files = entry->files;
+				result.success = true;
+			}
+			else
+			{
+				State state = { includeDir, result };
+
+				result.success = Expand(state, file, "");
+				result.source = state.out.str();
+			}
+
+			if (!defines.empty())
+			{
+				// '#version' has to come first, and precedes any include
+				size_t insertAt = 0;
+				int line = 1;
+
+				const size_t version = result.source.find("#version");
+				if (version != std::string::npos)
+				{
+					const size_t end = result.source.find('\n', version);
+					insertAt = end == std::string::npos ? result.source.size() : end + 1;
+					line += static_cast<int>(std::count(result.source.begin(), result.source.begin() + insertAt, '\n'));
+				}
+
+				std::string insert;
+				for (const std::string& define : defines)
+					insert += "#define " + define + " 1\n";
+
+				if (version != std::string::npos)
+					insert += "#line " + std::to_string(line) + " 0\n";
+
+				result.source.insert(insertAt, insert);
+			}
+
+			return result;
+		}
+
+		void Invalidate(const std::string& file)
+		{
+			g_files.erase(file);
+			ShaderArchive::Invalidate(file);
+		}
+
+		void ClearCache()
+		{
+			g_files.clear();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Graphics
+{
+	// Expands includes in shader-sources, either as '@file' or '#include "file"', resolved against the
+	// include-dir. Includes may be nested; files containing '#pragma once' are only expanded once per
+	// source. Parsed files are cached across all programs by path and modification-time, so shared 
+	// includes are read once. Files in the loaded ShaderArchive aren't read at all. Only used from the 
+	// rendering-thread.
+	namespace ShaderPreprocessor
+	{
+		struct Result
+		{
+			std::string source;
+
+			// Every file that went into 'source', the root file first. Indices match the source-string 
+			// numbers of the emitted '#line'-directives, so "1(12)" in a driver error is files[1], line 12.
+			std::vector<std::string> files;
+
+			bool success = false;
+		};
+
+		// 'defines' are inserted after the '#version'-line as '#define <name> 1'
+		Result Process(const std::string& file, const std::string& includeDir, const std::vector<std::string>& defines = std::vector<std::string>());
+
+		// Forces 'file' to be re-read, even if its modification-time (seconds on some file-systems) didn't 
+		// change, and stops using archived sources that include it
+		void Invalidate(const std::string& file);
+
+		// Drops all cached files
+		void ClearCache();
+	}
+}
\ No newline at end of file
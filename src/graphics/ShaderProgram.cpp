@@ -1,5 +1,7 @@
 #include "ShaderProgram.hpp"
 #include "OpenGL.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderPreprocessor.h"
 
 #include <string>
 #include <memory>
@@ -8,6 +10,8 @@
 #include <sstream>
 #include <exception>
 #include <unordered_map>
+#include <cassert>
+#include <algorithm>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -47,13 +51,17 @@ namespace ShaderUtils
 		return std::string(strInfoLog.get());
 	}
 
-	Status CompileShader(GLuint shader, const std::string &shaderText)
+	// Doesn't query the compile-status, which would wait for the driver to finish compiling
+	void CompileShader(GLuint shader, const std::string &shaderText)
 	{
 		const char *strFileData = shaderText.c_str();
 		glShaderSource(shader, 1, &strFileData, NULL);
 
 		glCompileShader(shader);
+	}
 
+	Status GetCompileStatus(GLuint shader)
+	{
 		GLint compileStatus;
 		glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
 
@@ -72,53 +80,6 @@ namespace ShaderUtils
 
 }
 
-static std::string LoadFile(const std::string& file, const std::string& includeDir)
-{
-	std::ifstream in(file);
-
-	if (!in.is_open())
-	{
-		std::cerr << "Couldn't load source from file " << file << std::endl;
-		return "";
-	}
-
-	std::stringstream buffer;
-
-	while (in.good())
-	{
-		std::string line;
-		std::getline(in, line);
-
-		if (line.length() > 1 && line.at(0) == '@')
-		{
-			std::string includeFile = includeDir + line.substr(1, line.find_first_of(' '));
-
-			std::ifstream inc(includeFile);
-
-			if (!inc.is_open())
-			{
-				std::cerr << "Couldn't include file '" << includeFile << "' while parsing " << file << std::endl;
-				//throw std::runtime_error("Couldn't include file '" + includeFile + "' while parsing " + file);
-			}
-			else
-			{
-				std::string includeString;
-				std::getline(inc, includeString, '\0');
-				buffer << includeString << "\n";
-			}
-			inc.close();
-		}
-		else
-		{
-			buffer << line << "\n";
-		}
-	}
-
-	in.close();
-
-	return buffer.str();
-}
-
 namespace Graphics
 {
 
@@ -138,13 +99,17 @@ namespace Graphics
 		return m_programId;
 	}
 
+	bool ShaderProgram::s_parallelCompile = false;
+
+	void ShaderProgram::SetParallelCompile(bool supported)
+	{
+		s_parallelCompile = supported;
+	}
+
 	bool ShaderProgram::Reload()
 	{
 		if (m_loadedFromFile)
 		{
-			// Invalidate uniform-location cache
-			m_uniformLocations.clear();
-
 			// Reload from files
 			return Load(m_shaderInfo);		
 		}
@@ -152,29 +117,55 @@ namespace Graphics
 		return true;
 	}
 
+	bool ShaderProgram::BeginReload()
+	{
+		if (!m_loadedFromFile)
+			return false;
+
+		BeginLoad(m_shaderInfo);
+		return true;
+	}
+
 	bool ShaderProgram::Load(const ShaderInfo& shaderInfo)
 	{
+		BeginLoad(shaderInfo);
+		return FinishLoad();
+	}
+
+	void ShaderProgram::BeginLoad(const ShaderInfo& shaderInfo)
+	{
+		// Superseded
+		if (m_pendingProgram != 0)
+			CancelLoad();
+
 		std::string includeDir = shaderInfo.includeDir;
 		m_shaderInfo = shaderInfo;
 		m_loadedFromFile = true;
-		m_successfullyLoaded = false;
 
-		struct Shader
+		std::vector<Shader>& shaders = m_pendingShaders;
+		shaders.clear();
+		m_dependencies.clear();
+
+		bool preprocessed = true;
+		auto loadSource = [&](Shader& s)
 		{
-			Shader() : handle(0), type(0) {};
-			std::string file; // Nice when reporting errors
-			std::string source;
-			GLuint handle;
-			GLenum type;
-		};
+			ShaderPreprocessor::Result result = ShaderPreprocessor::Process(s.file, includeDir, shaderInfo.defines);
+			preprocessed &= result.success;
+			s.source = std::move(result.source);
+			s.files = std::move(result.files);
 
-		std::vector<Shader> shaders;
+			for (const std::string& file : s.files)
+			{
+				if (std::find(m_dependencies.begin(), m_dependencies.end(), file) == m_dependencies.end())
+					m_dependencies.push_back(file);
+			}
+		};
 
 		if (shaderInfo.vsFile != "")
 		{
 			Shader s;
 			s.file = shaderInfo.vsFile;
-			s.source = LoadFile(s.file, includeDir);
+			loadSource(s);
 			s.type = GL_VERTEX_SHADER;
 			shaders.push_back(s);
 		}
@@ -183,7 +174,7 @@ namespace Graphics
 		{
 			Shader s;
 			s.file = shaderInfo.tcFile;
-			s.source = LoadFile(s.file, includeDir);
+			loadSource(s);
 			s.type = GL_TESS_CONTROL_SHADER;
 			shaders.push_back(s);
 		}
@@ -192,7 +183,7 @@ namespace Graphics
 		{
 			Shader s;
 			s.file = shaderInfo.teFile;
-			s.source = LoadFile(s.file, includeDir);
+			loadSource(s);
 			s.type = GL_TESS_EVALUATION_SHADER;
 			shaders.push_back(s);
 		}
@@ -201,7 +192,7 @@ namespace Graphics
 		{
 			Shader s;
 			s.file = shaderInfo.gsFile;
-			s.source = LoadFile(s.file, includeDir);
+			loadSource(s);
 			s.type = GL_GEOMETRY_SHADER;
 			shaders.push_back(s);
 		}
@@ -210,78 +201,187 @@ namespace Graphics
 		{
 			Shader s;
 			s.file = shaderInfo.fsFile;
-			s.source = LoadFile(s.file, includeDir);
+			loadSource(s);
 			s.type = GL_FRAGMENT_SHADER;
 			shaders.push_back(s);
 		}
 
-		if (m_programId == 0)
+		if (shaderInfo.csFile != "")
 		{
-			// Create program if necessary
-			m_programId = glCreateProgram();
+			assert(shaders.empty() && "Compute shaders can't be linked with other stages");
+
+			Shader s;
+			s.file = shaderInfo.csFile;
+			loadSource(s);
+			s.type = GL_COMPUTE_SHADER;
+			shaders.push_back(s);
 		}
 
-		// Create, attach, and compile
-		bool success = true;
-		std::string error;
-		for (Shader& s : shaders)
+		// Errors were reported by the preprocessor. Nothing is compiled, so a previously linked program
+		// stays in use; the files gathered so far are still watched, so fixing them triggers a reload.
+		if (!preprocessed)
 		{
-			s.handle = glCreateShader(s.type);
-			glAttachShader(m_programId, s.handle);
+			shaders.clear();
+			m_lastLoadSucceeded = false;
+			return;
+		}
 
-			ShaderUtils::Status status = ShaderUtils::CompileShader(s.handle, s.source);
-			if (status.success == false)
+		// A reload links into a new program; the current one stays in use until that succeeds
+		const bool replace = m_programId != 0 && m_successfullyLoaded;
+		const GLuint program = (m_programId == 0 || replace) ? glCreateProgram() : m_programId;
+
+		// Warm start; skips compilation entirely if the driver accepts the cached binary
+		m_pendingBinaryKey = 0;
+		if (ProgramBinaryCache::IsEnabled())
+		{
+			std::vector<std::pair<GLenum, std::string>> sources;
+			for (const Shader& s : shaders)
+				sources.emplace_back(s.type, s.source);
+
+			m_pendingBinaryKey = ProgramBinaryCache::ComputeKey(sources);
+			if (ProgramBinaryCache::Load(program, m_pendingBinaryKey))
 			{
-				// Continue so it reports compile-errors for all shaders
-				success = false;
-				error += "(" + s.file + ") ";
-				error += status.error;
-				continue;
+				shaders.clear();
+				SetProgram(program);
+				m_lastLoadSucceeded = true;
+				return;
 			}
+
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		}
 
-		// Mark shaders for deletion (done on detach)
+		// Create, attach, compile and link without checking any status in between, so the driver
+		// can work on it (and on other programs) until FinishLoad
 		for (Shader& s : shaders)
 		{
+			s.handle = glCreateShader(s.type);
+			glAttachShader(program, s.handle);
+			ShaderUtils::CompileShader(s.handle, s.source);
+
+			// Marked for deletion, done on detach
 			glDeleteShader(s.handle);
+			s.source.clear();
 		}
 
-		// Compilation failure
-		if (!success)
+		glLinkProgram(program);
+
+		m_pendingProgram = program;
+	}
+
+	bool ShaderProgram::IsLoadPending() const
+	{
+		return m_pendingProgram != 0;
+	}
+
+	bool ShaderProgram::IsLoadComplete() const
+	{
+		if (m_pendingProgram == 0 || !s_parallelCompile)
+			return true;
+
+		GLint completed = GL_FALSE;
+		glGetProgramiv(m_pendingProgram, GL_COMPLETION_STATUS_KHR, &completed);
+		return completed == GL_TRUE;
+	}
+
+	bool ShaderProgram::FinishLoad()
+	{
+		if (m_pendingProgram == 0)
+			return m_lastLoadSucceeded;
+
+		const GLuint program = m_pendingProgram;
+		m_pendingProgram = 0;
+
+		// Check link-status
+		GLint linkStatus;
+		glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+
+		std::string error;
+		if (linkStatus == GL_FALSE)
 		{
-			// Detach shaders
-			for (Shader& s : shaders)
+			// Report compile-errors for all shaders, if any, since the link-error would just refer to them
+			for (Shader& s : m_pendingShaders)
 			{
-				glDetachShader(m_programId, s.handle);
+				ShaderUtils::Status status = ShaderUtils::GetCompileStatus(s.handle);
+				if (status.success)
+					continue;
+
+				error += "(" + s.file + ") ";
+				if (s.files.size() > 1)
+				{
+					// Lines in included files are reported as "<source-string>(<line>)"
+					for (size_t i = 0; i < s.files.size(); ++i)
+						error += "[" + std::to_string(i) + ": " + s.files[i] + "] ";
+					error += "\n";
+				}
+				error += status.error;
 			}
 
+			if (error.empty())
+				error = ShaderUtils::InfoLogHelper(glGetProgramiv, glGetProgramInfoLog, program);
+		}
+
+		// Detach all shaders
+		for (Shader& s : m_pendingShaders)
+		{
+			glDetachShader(program, s.handle);
+		}
+		m_pendingShaders.clear();
+
+		if (linkStatus == GL_FALSE)
+		{
 			std::cerr << error << std::endl;
+			DiscardProgram(program);
+			m_lastLoadSucceeded = false;
 			return false;
 		}
 
-		// Link
-		glLinkProgram(m_programId);
+		if (ProgramBinaryCache::IsEnabled())
+			ProgramBinaryCache::Store(program, m_pendingBinaryKey);
 
-		// Detach all shaders
-		for (Shader& s : shaders)
+		SetProgram(program);
+		m_lastLoadSucceeded = true;
+
+		return true;
+	}
+
+	void ShaderProgram::CancelLoad()
+	{
+		for (Shader& s : m_pendingShaders)
 		{
-			glDetachShader(m_programId, s.handle);
+			glDetachShader(m_pendingProgram, s.handle);
 		}
+		m_pendingShaders.clear();
 
-		// Check link-status
-		GLint linkStatus;
-		glGetProgramiv(m_programId, GL_LINK_STATUS, &linkStatus);
+		DiscardProgram(m_pendingProgram);
+		m_pendingProgram = 0;
+	}
 
-		if (linkStatus == GL_FALSE)
+	void ShaderProgram::SetProgram(GLuint program)
+	{
+		if (m_programId != program)
 		{
-			const std::string& strInfoLog = ShaderUtils::InfoLogHelper(glGetProgramiv, glGetProgramInfoLog, m_programId);
-			std::cerr << strInfoLog << std::endl;
-			return false;
+			glDeleteProgram(m_programId);
+			m_programId = program;
 		}
 
+		// Locations and bindings may differ after every link
+		m_reflection.Reflect(m_programId);
+
 		m_successfullyLoaded = true;
+	}
 
-		return true;
+	void ShaderProgram::DiscardProgram(GLuint program)
+	{
+		// Keep the previous program if there is one
+		if (program != m_programId)
+			glDeleteProgram(program);
+		else
+			m_successfullyLoaded = false;
+	}
+
+	const std::vector<std::string>& ShaderProgram::GetDependencies() const
+	{
+		return m_dependencies;
 	}
 
 	bool ShaderProgram::IsLoaded() const
@@ -379,24 +479,29 @@ namespace Graphics
 
 	int ShaderProgram::GetUniformLocation(const std::string& name)
 	{
-		const auto& f = m_uniformLocations.find(name);
-		if (f != m_uniformLocations.end())
-		{
-			return f->second;
-		}
+		return m_reflection.GetLocation(InternUniformName(name));
+	}
 
-		GLint location = glGetUniformLocation(m_programId, name.c_str());
-		m_uniformLocations[name] = location;
+	int ShaderProgram::GetUniformLocation(UniformId id) const
+	{
+		return m_reflection.GetLocation(id);
+	}
 
-		return location;
+	const ShaderReflection& ShaderProgram::GetReflection() const
+	{
+		return m_reflection;
 	}
 
 	void ShaderProgram::DeleteProgram()
 	{
+		if (m_pendingProgram != 0)
+			CancelLoad();
+
 		if (m_programId != 0)
 		{
 			glDeleteProgram(m_programId);
 			m_programId = 0;
+			m_reflection.Clear();
 		}
 	}
 
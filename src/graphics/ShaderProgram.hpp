@@ -9,6 +9,7 @@
 
 #include "OpenGL.h"
 #include "ShaderInfo.h"
+#include "ShaderReflection.h"
 #include "glm/fwd.hpp"
 
 namespace Graphics
@@ -23,7 +24,18 @@ namespace Graphics
 		ShaderProgram(const ShaderProgram& other) = delete;
 		ShaderProgram& operator=(const ShaderProgram& other) = delete;
 
+		// Blocks until the program is linked
 		bool Load(const ShaderInfo& shaderInfo);
+
+		// Non-blocking loading: BeginLoad issues compilation and linking, FinishLoad checks the result
+		// (which blocks unless IsLoadComplete). A previously loaded program stays in use meanwhile.
+		void BeginLoad(const ShaderInfo& shaderInfo);
+		bool IsLoadPending() const;
+		bool IsLoadComplete() const; // Always true without KHR_parallel_shader_compile
+		bool FinishLoad();
+
+		// Whether the driver supports GL_KHR_parallel_shader_compile
+		static void SetParallelCompile(bool supported);
 		void DeleteProgram();
 
 		int GetAttribLocation(const std::string &s);
@@ -34,7 +46,8 @@ namespace Graphics
 		static bool UpdateUniform(int programId, int location, const glm::mat4& m);
 		static bool UpdateUniform(int programId, int location, float f);
 
-		int GetUniformLocation(const std::string& name);
+		int GetUniformLocation(const std::string& name); // Interns 'name'; prefer the id-version per draw
+		int GetUniformLocation(UniformId id) const;
 		bool UpdateUniform(const std::string&, const glm::mat4&);
 		bool UpdateUniform(const std::string&, const glm::vec2&);
 		bool UpdateUniform(const std::string&, const glm::vec3&);
@@ -45,9 +58,17 @@ namespace Graphics
 		int  GetProgram() const;
 		void UseProgram() const;
 
+		// On failure, a previously loaded program stays in use
 		bool Reload();
+		bool BeginReload(); // False if not loaded from files
 		bool IsLoaded() const;
 
+		// Of the program in use; updated whenever a load succeeds
+		const ShaderReflection& GetReflection() const;
+
+		// Source- and include-files of the last Load
+		const std::vector<std::string>& GetDependencies() const;
+
 	private:
 		// Disallows automatic type conversions (since 
 		// there are different glUniform*-functions for ints, floats, etc.)
@@ -55,12 +76,35 @@ namespace Graphics
 		template<typename T> void UpdateUniform(std::string, T arg);
 		template<typename T> void UpdateUniform(int programId, int location, T arg);
 
-		std::unordered_map<std::string, GLint> m_uniformLocations;
+		struct Shader
+		{
+			Shader() : handle(0), type(0) {};
+			std::string file; // Nice when reporting errors
+			std::string source;
+			std::vector<std::string> files; // Source-string numbers in errors index into this
+			GLuint handle;
+			GLenum type;
+		};
+
+		void CancelLoad();
+		void SetProgram(GLuint program);
+		void DiscardProgram(GLuint program);
+
+		ShaderReflection m_reflection;
 
 		unsigned int m_programId = 0;
 		ShaderInfo   m_shaderInfo;
+		std::vector<std::string> m_dependencies;
 		bool         m_loadedFromFile = false;
 		bool         m_successfullyLoaded = false;
+
+		// Between BeginLoad and FinishLoad
+		GLuint              m_pendingProgram = 0;
+		std::vector<Shader> m_pendingShaders;
+		uint64_t            m_pendingBinaryKey = 0;
+		bool                m_lastLoadSucceeded = false;
+
+		static bool s_parallelCompile;
 	};
 
 }
@@ -0,0 +1,143 @@
+#include "ShaderReflection.h"
+
+#include <unordered_map>
+#include <mutex>
+#include <deque>
+#include <cassert>
+
+namespace Graphics
+{
+	namespace
+	{
+		// Deque keeps references returned by GetUniformName valid
+		std::mutex g_namesMutex;
+		std::unordered_map<std::string, UniformId> g_ids;
+		std::deque<std::string> g_names;
+
+		// Whether 'type' is bound to a unit, and to which kind
+		bool GetOpaqueBindingType(GLenum type, BindingType& outType)
+		{
+			switch (type)
+			{
+			case GL_SAMPLER_1D:
+			case GL_SAMPLER_2D:
+			case GL_SAMPLER_3D:
+			case GL_SAMPLER_CUBE:
+			case GL_SAMPLER_2D_SHADOW:
+			case GL_SAMPLER_2D_ARRAY:
+			case GL_SAMPLER_2D_ARRAY_SHADOW:
+			case GL_SAMPLER_CUBE_SHADOW:
+			case GL_SAMPLER_2D_MULTISAMPLE:
+			case GL_SAMPLER_BUFFER:
+			case GL_INT_SAMPLER_2D:
+			case GL_INT_SAMPLER_2D_ARRAY:
+			case GL_UNSIGNED_INT_SAMPLER_2D:
+			case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+				outType = BindingType::Sampler;
+				return true;
+			case GL_IMAGE_2D:
+			case GL_IMAGE_3D:
+			case GL_IMAGE_2D_ARRAY:
+			case GL_IMAGE_BUFFER:
+			case GL_INT_IMAGE_2D:
+			case GL_UNSIGNED_INT_IMAGE_2D:
+				outType = BindingType::Image;
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		std::string GetResourceName(GLuint program, GLenum interface, GLuint index, GLint length)
+		{
+			std::string name(length, '\0');
+			glGetProgramResourceName(program, interface, index, length, NULL, &name[0]);
+			name.resize(name.find('\0') == std::string::npos ? name.size() : name.find('\0'));
+
+			// Arrays are reported as their first element
+			const size_t bracket = name.find("[0]");
+			if (bracket != std::string::npos && bracket + 3 == name.size())
+				name.resize(bracket);
+
+			return name;
+		}
+
+		void ReflectBlocks(GLuint program, GLenum interface, BindingType type, std::vector<ShaderReflection::Binding>& out)
+		{
+			GLint count = 0;
+			glGetProgramInterfaceiv(program, interface, GL_ACTIVE_RESOURCES, &count);
+
+			const GLenum props[] = { GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+			for (GLint i = 0; i < count; ++i)
+			{
+				GLint values[3];
+				glGetProgramResourceiv(program, interface, i, 3, props, 3, NULL, values);
+
+				const UniformId id = InternUniformName(GetResourceName(program, interface, i, values[0]));
+				out.push_back({ id, type, values[1], values[2] });
+			}
+		}
+	}
+
+	UniformId InternUniformName(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(g_namesMutex);
+
+		const auto& f = g_ids.find(name);
+		if (f != g_ids.end())
+			return f->second;
+
+		assert(g_names.size() < UINT16_MAX);
+		const UniformId id = static_cast<UniformId>(g_names.size());
+		g_names.push_back(name);
+		g_ids.emplace(name, id);
+		return id;
+	}
+
+	const std::string& GetUniformName(UniformId id)
+	{
+		std::lock_guard<std::mutex> lock(g_namesMutex);
+		return g_names[id];
+	}
+
+	void ShaderReflection::Reflect(GLuint program)
+	{
+		Clear();
+
+		GLint count = 0;
+		glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+
+		const GLenum props[] = { GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_BLOCK_INDEX };
+		for (GLint i = 0; i < count; ++i)
+		{
+			GLint values[4];
+			glGetProgramResourceiv(program, GL_UNIFORM, i, 4, props, 4, NULL, values);
+
+			// Members of blocks are covered by the block
+			if (values[3] != -1 || values[2] == -1)
+				continue;
+
+			const UniformId id = InternUniformName(GetResourceName(program, GL_UNIFORM, i, values[0]));
+			if (id >= locations.size())
+				locations.resize(id + 1, -1);
+			locations[id] = values[2];
+
+			BindingType type;
+			if (GetOpaqueBindingType(values[1], type))
+			{
+				GLint unit = 0;
+				glGetUniformiv(program, values[2], &unit);
+				bindings.push_back({ id, type, unit, 0 });
+			}
+		}
+
+		ReflectBlocks(program, GL_UNIFORM_BLOCK, BindingType::UniformBlock, bindings);
+		ReflectBlocks(program, GL_SHADER_STORAGE_BLOCK, BindingType::StorageBlock, bindings);
+	}
+
+	void ShaderReflection::Clear()
+	{
+		locations.clear();
+		bindings.clear();
+	}
+}
\ No newline at end of file
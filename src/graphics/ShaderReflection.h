@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "OpenGL.h"
+#include "EnumsFlags.h"
+
+namespace Graphics
+{
+	// Names of uniforms, samplers and blocks are interned once into small ids, so per-draw lookups 
+	// index arrays instead of hashing strings. Ids are shared by all programs.
+	typedef uint16_t UniformId;
+
+	UniformId InternUniformName(const std::string& name);
+	const std::string& GetUniformName(UniformId id);
+
+	// Active resources of a linked program, gathered once at link-time
+	struct ShaderReflection
+	{
+		struct Binding
+		{
+			UniformId id;
+			BindingType type;
+			GLint index;    // Unit or binding-point
+			GLint dataSize; // Of blocks, 0 for samplers and images
+		};
+
+		void Reflect(GLuint program);
+		void Clear();
+
+		GLint GetLocation(UniformId id) const
+		{
+			return id < locations.size() ? locations[id] : -1;
+		}
+
+		std::vector<GLint> locations; // Of default-block uniforms indexed by UniformId, -1 if inactive
+		std::vector<Binding> bindings;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "ShaderWatcher.h"
+
+#include <cstdio>
+#include <algorithm>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+namespace Graphics
+{
+	ShaderWatcher::ShaderWatcher()
+	{
+
+	}
+
+	ShaderWatcher::~ShaderWatcher()
+	{
+		Shutdown();
+	}
+
+#ifdef __linux__
+	bool ShaderWatcher::Init()
+	{
+		m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_fd < 0)
+		{
+			perror("inotify_init1");
+			return false;
+		}
+
+		return true;
+	}
+
+	void ShaderWatcher::Shutdown()
+	{
+		if (m_fd >= 0)
+		{
+			close(m_fd);
+			m_fd = -1;
+		}
+
+		m_watches.clear();
+	}
+
+	void ShaderWatcher::Watch(const std::string& file)
+	{
+		if (m_fd < 0)
+			return;
+
+		const size_t slash = file.find_last_of("/\\");
+		const std::string directory = slash == std::string::npos ? "." : file.substr(0, slash + 1);
+		const std::string name = slash == std::string::npos ? file : file.substr(slash + 1);
+
+		// Returns the existing descriptor if the directory is already watched
+		const int wd = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (wd < 0)
+		{
+			// Shaders may only be in the archive
+			if (errno != ENOENT)
+				fprintf(stderr, "ShaderWatcher: couldn't watch %s\n", directory.c_str());
+			return;
+		}
+
+		m_watches[wd][name] = file;
+	}
+
+	void ShaderWatcher::Poll(std::vector<std::string>& changed)
+	{
+		if (m_fd < 0)
+			return;
+
+		alignas(inotify_event) char buffer[4096];
+		for (;;)
+		{
+			const ssize_t length = read(m_fd, buffer, sizeof(buffer));
+			if (length <= 0)
+				break; // EAGAIN once drained
+
+			for (ssize_t offset = 0; offset < length; )
+			{
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+				offset += sizeof(inotify_event) + event->len;
+
+				if (event->len == 0)
+					continue;
+
+				const auto& watch = m_watches.find(event->wd);
+				if (watch == m_watches.end())
+					continue;
+
+				const auto& file = watch->second.find(event->name);
+				if (file == watch->second.end())
+					continue;
+
+				// Editors often produce several events per save
+				if (std::find(changed.begin(), changed.end(), file->second) == changed.end())
+					changed.push_back(file->second);
+			}
+		}
+	}
+#else
+	namespace
+	{
+		int64_t GetModificationTime(const std::string& file)
+		{
+			struct stat st;
+			if (stat(file.c_str(), &st) != 0)
+				return 0;
+
+			return static_cast<int64_t>(st.st_mtime);
+		}
+	}
+
+	bool ShaderWatcher::Init()
+	{
+		return true;
+	}
+
+	void ShaderWatcher::Shutdown()
+	{
+		m_mtimes.clear();
+	}
+
+	void ShaderWatcher::Watch(const std::string& file)
+	{
+		if (m_mtimes.find(file) == m_mtimes.end())
+			m_mtimes[file] = GetModificationTime(file);
+	}
+
+	void ShaderWatcher::Poll(std::vector<std::string>& changed)
+	{
+		for (auto& file : m_mtimes)
+		{
+			const int64_t mtime = GetModificationTime(file.first);
+			if (mtime != file.second)
+			{
+				file.second = mtime;
+				changed.push_back(file.first);
+			}
+		}
+	}
+#endif
+}
\ No newline at end of file
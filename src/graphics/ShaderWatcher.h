@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+namespace Graphics
+{
+	// Reports changes to watched files. Uses inotify on Linux, watching the files' directories so saves
+	// that replace the file (write to temporary and rename) are seen too; elsewhere it compares 
+	// modification-times on every Poll.
+	class ShaderWatcher
+	{
+	public:
+		ShaderWatcher();
+		~ShaderWatcher();
+
+		// Noncopyable
+		ShaderWatcher(const ShaderWatcher& other) = delete;
+		ShaderWatcher& operator=(const ShaderWatcher& other) = delete;
+
+		bool Init();
+		void Shutdown();
+
+		void Watch(const std::string& file);
+
+		// Non-blocking; appends the watched files that changed since the last call
+		void Poll(std::vector<std::string>& changed);
+
+	private:
+#ifdef __linux__
+		int m_fd = -1;
+
+		// Watch-descriptor -> file-name within the directory -> watched path
+		std::unordered_map<int, std::unordered_map<std::string, std::string>> m_watches;
+#else
+		std::unordered_map<std::string, int64_t> m_mtimes;
+#endif
+	};
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include "TextureUtils.h"
+
+#include <algorithm>
+
+namespace Graphics
+{
+	GLsizei NumMipLevels(uint16_t width, uint16_t height)
+	{
+		GLsizei levels = 1;
+		for (uint16_t size = std::max(width, height); size > 1; size >>= 1)
+			++levels;
+		return levels;
+	}
+
+	void GenerateLayerMipmaps(GLuint texture, GLenum format, uint16_t layer, uint16_t width, uint16_t height)
+	{
+		GLuint view = 0;
+		glGenTextures(1, &view);
+		glTextureView(view, GL_TEXTURE_2D, texture, format, 0, NumMipLevels(width, height), layer, 1);
+		glGenerateTextureMipmapEXT(view, GL_TEXTURE_2D);
+		glDeleteTextures(1, &view);
+	}
+
+	void ClearTexture2DArray(GLuint texture, uint16_t width, uint16_t height, uint16_t layers, const uint8_t rgba[4])
+	{
+		const GLsizei levels = NumMipLevels(width, height);
+
+		if (GLEW_ARB_clear_texture)
+		{
+			for (GLsizei level = 0; level < levels; ++level)
+				glClearTexImage(texture, level, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+			return;
+		}
+
+		// One layer of level 0, reused for every layer and level
+		GLuint pbo = 0;
+		glGenBuffers(1, &pbo);
+		glNamedBufferDataEXT(pbo, static_cast<GLsizeiptr>(width) * height * 4, NULL, GL_STATIC_DRAW);
+		glClearNamedBufferDataEXT(pbo, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+
+		for (GLsizei level = 0; level < levels; ++level)
+		{
+			const GLsizei levelWidth = std::max(width >> level, 1);
+			const GLsizei levelHeight = std::max(height >> level, 1);
+
+			for (uint16_t layer = 0; layer < layers; ++layer)
+			{
+				glTextureSubImage3DEXT(texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levelWidth, levelHeight, 1,
+					GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			}
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		// Deleted once the copies are done
+		glDeleteBuffers(1, &pbo);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "OpenGL.h"
+
+namespace Graphics
+{
+	// Levels of a full mipmap-chain
+	GLsizei NumMipLevels(uint16_t width, uint16_t height);
+
+	// Generates the mipmaps of one layer of an immutable 2D-array texture through a view of it, so 
+	// the array's other layers (possibly still uploading) are left alone.
+	void GenerateLayerMipmaps(GLuint texture, GLenum format, uint16_t layer, uint16_t width, uint16_t height);
+
+	// Fills every level of every layer with one RGBA8-color without any data from client memory: 
+	// cleared directly with ARB_clear_texture, otherwise copied from a buffer cleared on the GPU.
+	void ClearTexture2DArray(GLuint texture, uint16_t width, uint16_t height, uint16_t layers, const uint8_t rgba[4]);
+}
\ No newline at end of file
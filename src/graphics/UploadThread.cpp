@@ -0,0 +1,182 @@
+#include "UploadThread.h"
+#include "HeadlessContext.h"
+#include "TextureUtils.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace Graphics
+{
+	UploadThread::~UploadThread()
+	{
+		Shutdown();
+	}
+
+	bool UploadThread::Init(GLFWwindow* shareWindow, HeadlessContext* shareHeadlessContext)
+	{
+		if (shareHeadlessContext)
+		{
+			m_headlessContext.reset(new HeadlessContext);
+			if (!m_headlessContext->InitShared(*shareHeadlessContext))
+			{
+				m_headlessContext.reset();
+				return false;
+			}
+		}
+		else
+		{
+			// Uses the hints of the shared window (version, profile, ...)
+			glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+			m_window = glfwCreateWindow(1, 1, "", NULL, shareWindow);
+			glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+
+			if (!m_window)
+			{
+				fprintf(stderr, "UploadThread: creating shared context failed.\n");
+				return false;
+			}
+		}
+
+		m_shouldExit = false;
+		m_thread = std::thread([this] { Run(); });
+
+		return true;
+	}
+
+	void UploadThread::Shutdown()
+	{
+		if (!m_thread.joinable())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_shouldExit = true;
+		}
+		m_cv.notify_one();
+
+		m_thread.join();
+
+		if (m_window)
+			glfwDestroyWindow(m_window);
+		m_window = nullptr;
+
+		m_headlessContext.reset();
+	}
+
+	void UploadThread::Submit(std::vector<Job>& jobs, GLsync ready)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_batches.push_back({ ready, std::move(jobs) });
+		}
+		m_cv.notify_one();
+
+		jobs.clear();
+	}
+
+	void UploadThread::TakeCompleted(std::vector<Completed>& out)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		out.insert(out.end(), m_completed.begin(), m_completed.end());
+		m_completed.clear();
+	}
+
+	void UploadThread::Run()
+	{
+		MakeContextCurrent(true);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		while (true)
+		{
+			m_cv.wait(lock, [this] { return m_shouldExit || !m_batches.empty(); });
+
+			if (m_shouldExit)
+				break;
+
+			Batch batch = std::move(m_batches.front());
+			m_batches.pop_front();
+
+			lock.unlock();
+
+			// Waits on the GPU only, for the textures created by the rendering-context
+			glWaitSync(batch.ready, 0, GL_TIMEOUT_IGNORED);
+			glDeleteSync(batch.ready);
+
+			std::vector<Completed> completed;
+			for (const Job& job : batch.jobs)
+			{
+				Upload(job);
+
+				// Flushed so the rendering-context will see it signal
+				GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				glFlush();
+
+				completed.push_back({ job.handle, job.texture, job.target, fence });
+			}
+
+			lock.lock();
+			m_completed.insert(m_completed.end(), completed.begin(), completed.end());
+		}
+
+		// Nobody will take these any more; textures not yet adopted by the rendering-context are ours
+		for (auto& batch : m_batches)
+		{
+			for (auto& job : batch.jobs)
+			{
+				if (job.target == GL_TEXTURE_2D)
+					glDeleteTextures(1, &job.texture);
+				free(job.data);
+			}
+			glDeleteSync(batch.ready);
+		}
+		m_batches.clear();
+
+		for (auto& done : m_completed)
+		{
+			if (done.target == GL_TEXTURE_2D)
+				glDeleteTextures(1, &done.texture);
+			glDeleteSync(done.fence);
+		}
+		m_completed.clear();
+
+		lock.unlock();
+
+		MakeContextCurrent(false);
+	}
+
+	void UploadThread::Upload(const Job& job)
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		if (job.target == GL_TEXTURE_2D_ARRAY)
+		{
+			glTextureSubImage3DEXT(job.texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, job.layer, job.width, job.height, 1, 
+				GL_RGBA, GL_UNSIGNED_BYTE, job.data);
+			GenerateLayerMipmaps(job.texture, job.format, job.layer, job.width, job.height);
+		}
+		else
+		{
+			glTextureSubImage2DEXT(job.texture, GL_TEXTURE_2D, 0, 0, 0, job.width, job.height, 
+				GL_RGBA, GL_UNSIGNED_BYTE, job.data);
+			glGenerateTextureMipmapEXT(job.texture, GL_TEXTURE_2D);
+		}
+
+		free(job.data);
+	}
+
+	void UploadThread::MakeContextCurrent(bool current)
+	{
+		if (m_headlessContext)
+		{
+			if (current)
+				m_headlessContext->MakeCurrent();
+			else
+				m_headlessContext->ReleaseCurrent();
+		}
+		else
+		{
+			glfwMakeContextCurrent(current ? m_window : NULL);
+		}
+	}
+}
\ No newline at end of file
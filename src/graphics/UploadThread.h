@@ -0,0 +1,83 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <memory>
+
+#include "OpenGL.h"
+#include "Handles.h"
+
+namespace Graphics
+{
+	class HeadlessContext;
+
+	// Uploads texture-data on its own GL-context (sharing objects with the rendering-context), so 
+	// large uploads don't take time from the rendering-thread. Textures are created by the rendering-
+	// thread; both sides synchronize through fences and never wait on the CPU for the other.
+	class UploadThread
+	{
+	public:
+		struct Job
+		{
+			Texture2DHandle handle; // Invalid for array-layers
+			GLuint texture;
+			GLenum target; // GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY
+			GLenum format; // Internal format, used by array-layers
+			uint16_t layer;
+			void* data; // Freed once uploaded
+			uint16_t width;
+			uint16_t height;
+		};
+
+		struct Completed
+		{
+			Texture2DHandle handle;
+			GLuint texture;
+			GLenum target;
+			GLsync fence; // Signaled when the upload is done; owned by the receiver
+		};
+
+		UploadThread() = default;
+		~UploadThread();
+
+		UploadThread(const UploadThread&) = delete;
+		UploadThread& operator=(const UploadThread&) = delete;
+
+		// Creates the shared context, so must be called on the main-thread while the context it shares
+		// with (either the window's or the headless one) isn't current on any other thread.
+		bool Init(GLFWwindow* shareWindow, HeadlessContext* shareHeadlessContext);
+		void Shutdown();
+
+		// Called by the rendering-thread. 'ready' must be signaled after the jobs' textures were created 
+		// (and be flushed); ownership of it and of the jobs' data is transferred.
+		void Submit(std::vector<Job>& jobs, GLsync ready);
+
+		// Appends uploads finished since the last call
+		void TakeCompleted(std::vector<Completed>& out);
+
+	private:
+		void Run();
+		void Upload(const Job& job);
+		void MakeContextCurrent(bool current);
+
+		struct Batch
+		{
+			GLsync ready;
+			std::vector<Job> jobs;
+		};
+
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+		std::deque<Batch> m_batches;
+		std::vector<Completed> m_completed;
+		bool m_shouldExit = false;
+
+		GLFWwindow* m_window = nullptr; // Hidden
+		std::unique_ptr<HeadlessContext> m_headlessContext;
+
+		std::thread m_thread;
+	};
+}
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <fstream>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+#include <cstdlib>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -18,9 +20,14 @@
 #include "LoadUtils.h"
 
 #include "Renderable.h"
+#include "TransformStore.h"
 #include "Material.h"
+#include "ShaderVariants.h"
 
 #include "FrustumCuller.h"
+#include "RenderQueue.h"
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
 #include "PostProcess.h"
 #include "TextureLoader.h"
 #include "LightManager.h"
@@ -29,24 +36,108 @@ namespace
 {
 	const std::string dataFolder = "data/";
 
-	void DrawRenderables(Graphics::RenderingSystem& renderingSystem, std::vector<Renderable>& renderables, const std::vector<bool>& isCulled, Graphics::BufferHandle& perDrawUBOHandle)
+	// Renderables at least this large (world-space bounding radius) are drawn conditionally on an 
+	// occlusion query of their bounding box from the previous frame
+	const float OCCLUSION_QUERY_MIN_RADIUS = 0.5f;
+
+	// The bounding box can't be used for occlusion when the camera is inside it (or near enough to clip it)
+	bool IsInsideOcclusionProxy(const glm::vec4& sphere, const glm::vec3& cameraPosition, float nearPlane)
+	{
+		const glm::vec3 distance = glm::abs(cameraPosition - glm::vec3(sphere.x, sphere.y, sphere.z));
+		const float extent = sphere.w + nearPlane * 2.0f;
+		return distance.x < extent && distance.y < extent && distance.z < extent;
+	}
+
+	// Each material is drawn with the shader-variant for its features plus 'globalFeatures'
+	void DrawRenderables(Graphics::RenderingSystem& renderingSystem, std::vector<Renderable>& renderables, const TransformStore& transforms, const FrustumCuller& frustumCuller,
+		const FrustumCuller::VisibleList& visible, Graphics::BufferHandle& perDrawUBOHandle, ShaderVariants& shaderVariants, uint32_t globalFeatures, bool conditionalRendering,
+		const glm::vec3& cameraPosition, float nearPlane, uint32_t frame)
 	{
 		DrawUBO perDrawUBO;
+		uint32_t boundFeatures = ~0u;
 
-		for (size_t i = 0; i < renderables.size(); ++i)
+		for (uint32_t i : visible)
 		{
-			if (isCulled[i])
-				continue;
-
 			Renderable& renderable = renderables[i];
+
+			// Drawn in material-order, so by shader-features first
+			const uint32_t features = DeferredShaderFeature::Combine(renderable.GetMaterial().GetShaderFeatures(), globalFeatures);
+			if (features != boundFeatures)
+			{
+				renderingSystem.UseShaderProgram(shaderVariants.Get(renderingSystem, features));
+				boundFeatures = features;
+			}
+
 			renderable.GetMaterial().Bind(renderingSystem);
 
-			perDrawUBO.modelMatrix = renderable.GetModelMatrix();
+			perDrawUBO.modelMatrix = transforms.GetWorldMatrix(renderable.GetTransform());
 			renderingSystem.UpdateBuffer(perDrawUBOHandle, &perDrawUBO, sizeof(perDrawUBO), Graphics::BufferType::DYNAMIC);
 
+			// Only last frame's query is used; renderables that weren't queried then (e.g. since they were culled)
+			// would otherwise be hidden by an old result
+			const bool conditional = conditionalRendering && renderable.GetOcclusionQuery().IsValid() && 
+				frame > 0 && renderable.WasOcclusionQueryIssued(frame - 1) &&
+				!IsInsideOcclusionProxy(frustumCuller.GetSphere(i), cameraPosition, nearPlane);
+
+			if (conditional)
+				renderingSystem.BeginConditionalRender(renderable.GetOcclusionQuery());
+
 			renderingSystem.Draw(renderable.GetMesh().vertexBuffer, renderable.GetMesh().indexBuffer, renderable.GetMesh().numElements);
+
+			if (conditional)
+				renderingSystem.EndConditionalRender();
+		}
+	}
+
+	// Issues the occlusion queries used by DrawRenderables next frame; expects the depth-buffer to be filled 
+	// and the occlusion-proxy shader to be bound.
+	void DrawOcclusionProxies(Graphics::RenderingSystem& renderingSystem, std::vector<Renderable>& renderables, const FrustumCuller& frustumCuller, const FrustumCuller::VisibleList& visible,
+		Graphics::BufferHandle& perDrawUBOHandle, Graphics::BufferHandle cubeVertexBuffer, Graphics::BufferHandle cubeIndexBuffer, const glm::vec3& cameraPosition, float nearPlane,
+		uint32_t frame)
+	{
+		DrawUBO perDrawUBO;
+
+		for (uint32_t i : visible)
+		{
+			Renderable& renderable = renderables[i];
+			if (!renderable.GetOcclusionQuery().IsValid())
+				continue;
+
+			// From inside, the box's back-faces are culled and nothing passes, which would hide the renderable next frame
+			const glm::vec4 sphere = frustumCuller.GetSphere(i);
+			if (IsInsideOcclusionProxy(sphere, cameraPosition, nearPlane))
+				continue;
+
+			// Box enclosing the bounding sphere
+			perDrawUBO.modelMatrix = glm::translate(glm::mat4(), glm::vec3(sphere.x, sphere.y, sphere.z)) * glm::scale(glm::mat4(), glm::vec3(sphere.w));
+			renderingSystem.UpdateBuffer(perDrawUBOHandle, &perDrawUBO, sizeof(perDrawUBO), Graphics::BufferType::DYNAMIC);
+
+			renderingSystem.BeginQuery(renderable.GetOcclusionQuery());
+			renderingSystem.Draw(cubeVertexBuffer, cubeIndexBuffer, static_cast<uint32_t>(MeshUtils::cubeIndices.size()));
+			renderingSystem.EndQuery(renderable.GetOcclusionQuery());
+			renderable.SetOcclusionQueryFrame(frame);
 		}
 	}
+
+	// Writes bottom-to-top RGBA8-data (as returned by RenderingSystem::ReadRenderTarget) as an uncompressed TGA
+	bool WriteTGA(const std::string& filename, const void* rgba, uint16_t width, uint16_t height)
+	{
+		std::ofstream file(filename, std::ios::binary);
+		if (!file)
+			return false;
+
+		const uint8_t header[18] = { 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
+			uint8_t(width & 0xFF), uint8_t(width >> 8), uint8_t(height & 0xFF), uint8_t(height >> 8), 32, 8 };
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+		// TGA is BGRA
+		std::vector<uint8_t> bgra(static_cast<const uint8_t*>(rgba), static_cast<const uint8_t*>(rgba) + width * height * 4);
+		for (size_t i = 0; i < bgra.size(); i += 4)
+			std::swap(bgra[i], bgra[i + 2]);
+
+		file.write(reinterpret_cast<const char*>(bgra.data()), bgra.size());
+		return file.good();
+	}
 }
 
 int main(int argc, char* argv[])
@@ -57,6 +148,17 @@ int main(int argc, char* argv[])
 	wc.resizable = false;
 	wc.mode = Graphics::WindowMode::WINDOW;
 
+	// "--headless [frames]" renders the given number of frames offscreen and reports the average frame-time
+	int headlessFrames = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			wc.mode = Graphics::WindowMode::HEADLESS;
+			headlessFrames = (i + 1 < argc) ? std::max(atoi(argv[i + 1]), 1) : 1000;
+		}
+	}
+
 	Graphics::ContextConfig cc;
 	cc.msaaSamples = 4;
 	cc.debugContext = true;
@@ -76,9 +178,23 @@ int main(int argc, char* argv[])
 		return 1;
 	}
 
-	auto deferredShader = renderingSystem.CreateShaderProgram(
-		Graphics::ShaderInfo::VSFS("shaders/deferred.vs", "shaders/deferred.fs", "shaders/")
-		);
+	// Shaders hard-code these binding-points; programs binding them elsewhere are reported when loaded
+	renderingSystem.ExpectBinding(Graphics::BindingType::UniformBlock, "PerFrameUBO", Constants::PER_FRAME_UBO_BINDING_INDEX);
+	renderingSystem.ExpectBinding(Graphics::BindingType::UniformBlock, "PerDrawUBO", Constants::PER_DRAW_UBO_BINDING_INDEX);
+	renderingSystem.ExpectBinding(Graphics::BindingType::UniformBlock, "LightUBO", Constants::LIGHTS_UBO_BINDING_INDEX);
+	renderingSystem.ExpectBinding(Graphics::BindingType::UniformBlock, "MaterialUBO", Constants::MATERIAL_UBO_BINDING_INDEX);
+	renderingSystem.ExpectBinding(Graphics::BindingType::Sampler, "uSamplerDiffuse", Constants::MATERIAL_DIFF_TEX_UNIT);
+	renderingSystem.ExpectBinding(Graphics::BindingType::Sampler, "uSamplerNormalMap", Constants::MATERIAL_NORMAL_TEX_UNIT);
+	renderingSystem.ExpectBinding(Graphics::BindingType::Sampler, "uSamplerHeightMap", Constants::MATERIAL_HEIGHT_TEX_UNIT);
+	renderingSystem.ExpectBinding(Graphics::BindingType::Sampler, "uSamplerSpecular", Constants::MATERIAL_SPECULAR_TEX_UNIT);
+	renderingSystem.ExpectBinding(Graphics::BindingType::Sampler, "uSamplerDiffuseArray", Constants::MATERIAL_DIFF_ARRAY_TEX_UNIT);
+	renderingSystem.ExpectBinding(Graphics::BindingType::Sampler, "uSamplerNormalArray", Constants::MATERIAL_NORMAL_ARRAY_TEX_UNIT);
+	renderingSystem.ExpectBinding(Graphics::BindingType::Sampler, "uSamplerHeightArray", Constants::MATERIAL_HEIGHT_ARRAY_TEX_UNIT);
+
+	// Specialized per material and for the normal-/parallax-mapping toggles
+	ShaderVariants deferredShaderVariants;
+	deferredShaderVariants.Init(Graphics::ShaderInfo::VSFS("shaders/deferred.vs", "shaders/deferred.fs", "shaders/"),
+		std::vector<std::string>(std::begin(DeferredShaderFeature::defines), std::end(DeferredShaderFeature::defines)));
 
 	auto deferredLightShader = renderingSystem.CreateShaderProgram(
 		Graphics::ShaderInfo::VSFS("shaders/deferredlight.vs", "shaders/deferredlight.fs", "shaders/")
@@ -88,10 +204,20 @@ int main(int argc, char* argv[])
 		Graphics::ShaderInfo::VSFS("shaders/copy.vs", "shaders/copy.fs", "shaders/")
 		);
 
+	auto occlusionProxyShader = renderingSystem.CreateShaderProgram(
+		Graphics::ShaderInfo::VSFS("shaders/occlusionproxy.vs", "shaders/occlusionproxy.fs", "shaders/")
+		);
+
 	// Full-screen quad
 	auto quadVertexBuffer = renderingSystem.CreateBuffer();
 	renderingSystem.UpdateBuffer(quadVertexBuffer, MeshUtils::quadVertices.data(), MeshUtils::quadVertices.size() * sizeof(float), Graphics::BufferType::STATIC);
 
+	// Bounding box for occlusion queries
+	auto cubeVertexBuffer = renderingSystem.CreateBuffer();
+	renderingSystem.UpdateBuffer(cubeVertexBuffer, MeshUtils::cubeVertices.data(), MeshUtils::cubeVertices.size() * sizeof(float), Graphics::BufferType::STATIC);
+	auto cubeIndexBuffer = renderingSystem.CreateBuffer();
+	renderingSystem.UpdateBuffer(cubeIndexBuffer, MeshUtils::cubeIndices.data(), MeshUtils::cubeIndices.size() * sizeof(uint32_t), Graphics::BufferType::STATIC);
+
 	// Postprocessing
 	PostProcess_SSAO ssaoPP;
 	ssaoPP.Init(renderingSystem, quadVertexBuffer);
@@ -126,14 +252,32 @@ int main(int argc, char* argv[])
 	// Load the scene.
 	// This can take a while for big scenes, so it'll poll the window to keep it responsive.
 	std::vector<Renderable> renderables;
-	if (!GetRenderables(dataFolder, textureLoader, renderingSystem, renderables /*out*/))
+	TransformStore transforms;
+	OcclusionCuller occlusionCuller;
+	if (!GetRenderables(dataFolder, textureLoader, renderingSystem, renderables /*out*/, transforms /*out*/, &occlusionCuller))
 	{
 		return 0;
 	}
 
-	// Used for culling
-	std::vector<bool> isCulled;
-	FrustumCuller<Renderable> frustumCuller;
+	printf("%u software occluder-triangles\n", static_cast<unsigned>(occlusionCuller.GetNumOccluderTriangles()));
+
+	// Draw-order by material; the renderables themselves stay where they are
+	RenderQueue renderQueue;
+	for (uint32_t i = 0; i < renderables.size(); ++i)
+		renderQueue.Insert(i, renderables[i].GetMaterial().GetSortKey());
+	renderQueue.Sort();
+
+	// Used for culling, indexed like 'renderables'
+	FrustumCuller::VisibleList visible;
+	FrustumCuller frustumCuller;
+	frustumCuller.Resize(renderables.size());
+	for (uint32_t i = 0; i < renderables.size(); ++i)
+	{
+		const uint32_t transform = renderables[i].GetTransform();
+		frustumCuller.SetSphere(i, transforms.GetPosition(transform), renderables[i].GetMesh().radius * transforms.GetScale(transform));
+	}
+	frustumCuller.Build();
+	ThreadPool threadPool;
 
 	glm::vec3 cameraPosition(0, 2, 0);
 	glm::quat cameraOrientation;
@@ -143,10 +287,41 @@ int main(int argc, char* argv[])
 
 	bool parallaxMappingEnabled = true;
 	bool normalMappingEnabled = true;
+	bool occlusionQueriesEnabled = true;
+	bool softwareOcclusionEnabled = true;
+	uint32_t softwareOccluded = 0;
+
+	// Create all variants now, so toggling doesn't wait for compilation
+	{
+		const uint32_t globalFeatures[] = { 0, DeferredShaderFeature::NormalMapping, DeferredShaderFeature::ParallaxMapping,
+			DeferredShaderFeature::NormalMapping | DeferredShaderFeature::ParallaxMapping };
+
+		for (const auto& renderable : renderables)
+		{
+			for (uint32_t global : globalFeatures)
+				deferredShaderVariants.Get(renderingSystem, DeferredShaderFeature::Combine(renderable.GetMaterial().GetShaderFeatures(), global));
+		}
+
+		printf("%u deferred shader-variants\n", static_cast<unsigned>(deferredShaderVariants.GetNumVariants()));
+	}
+
+	for (auto& renderable : renderables)
+	{
+		if (renderable.GetMesh().radius * transforms.GetScale(renderable.GetTransform()) >= OCCLUSION_QUERY_MIN_RADIUS)
+			renderable.SetOcclusionQuery(renderingSystem.CreateQuery(Graphics::QueryType::AnySamplesPassed));
+	}
+
+	// GPU-time of the G-buffer pass, reported with the FPS
+	Graphics::QueryHandle gBufferTimer = renderingSystem.CreateQuery(Graphics::QueryType::TimeElapsed);
+
+	bool screenshotRequested = false;
+	int screenshots = 0;
 
 	int frames = 0;
+	int totalFrames = 0;
 	double timeAccum = 0.0;
 	double lastTime = 0.0;
+	const double startTime = renderingSystem.GetTime();
 
 	while (!renderingSystem.CloseRequested())
 	{
@@ -155,12 +330,6 @@ int main(int argc, char* argv[])
 		lastTime = time;
 		timeAccum += dt;
 
-		// Sort renderables by material (could only be done once since it's not dynamic)
-		std::sort(renderables.begin(), renderables.end(), [](const Renderable& a, const Renderable& b)
-		{
-			return a.GetMaterial() < b.GetMaterial();
-		});
-
 		// Update movement
 		glm::vec3 movement(0, 0, 0);
 		if (renderingSystem.IsKeyDown(Graphics::RenderingSystem::Key::W)) movement.z -= 1.0f;
@@ -214,8 +383,21 @@ int main(int argc, char* argv[])
 		// Update lights
 		lightManager.Update(time, cameraPosition);
 
+		// Rebuild the matrices of moved renderables; free while nothing moves
+		transforms.Update();
+
 		// Do frustum-culling
-		frustumCuller.Cull(renderables, isCulled, perFrameUBO.proj * perFrameUBO.view);
+		frustumCuller.Cull(visible, perFrameUBO.proj * perFrameUBO.view, &threadPool);
+
+		// Remove what's hidden behind the occluders
+		if (softwareOcclusionEnabled)
+		{
+			occlusionCuller.Render(perFrameUBO.proj * perFrameUBO.view, &threadPool);
+			softwareOccluded = occlusionCuller.Cull(visible, frustumCuller);
+		}
+
+		// Back to material-order
+		renderQueue.Order(visible.indices.data(), visible.count);
 #if 1
 		// Draw to G-buffer
 		{
@@ -226,12 +408,37 @@ int main(int argc, char* argv[])
 			renderingSystem.ClearScreen(Graphics::ClearState::AllBuffers());
 
 			// Prepare to fill it
-			renderingSystem.UseShaderProgram(deferredShader);
 			renderingSystem.BindUniformBuffer(Constants::PER_FRAME_UBO_BINDING_INDEX, perFrameUBOHandle);
 			renderingSystem.BindUniformBuffer(Constants::PER_DRAW_UBO_BINDING_INDEX, perDrawUBOHandle);
 
 			// Draw objects
-			DrawRenderables(renderingSystem, renderables, isCulled, perDrawUBOHandle);
+			renderingSystem.BeginQuery(gBufferTimer);
+			uint32_t globalShaderFeatures = 0;
+			if (normalMappingEnabled)
+				globalShaderFeatures |= DeferredShaderFeature::NormalMapping;
+			if (parallaxMappingEnabled)
+				globalShaderFeatures |= DeferredShaderFeature::ParallaxMapping;
+
+			DrawRenderables(renderingSystem, renderables, transforms, frustumCuller, visible, perDrawUBOHandle, deferredShaderVariants, globalShaderFeatures, 
+				occlusionQueriesEnabled, cameraPosition, perFrameUBO.nearPlane, static_cast<uint32_t>(totalFrames));
+			renderingSystem.EndQuery(gBufferTimer);
+
+			// Test bounding boxes against the finished depth-buffer for next frame
+			if (occlusionQueriesEnabled)
+			{
+				Graphics::ColorMask previousColorMask;
+				bool previousDepthMask;
+				renderingSystem.GetWriteMask(previousColorMask, previousDepthMask);
+
+				Graphics::ColorMask noColor;
+				noColor.SetAll(false);
+
+				renderingSystem.SetWriteMask(noColor, false);
+				renderingSystem.UseShaderProgram(occlusionProxyShader);
+				DrawOcclusionProxies(renderingSystem, renderables, frustumCuller, visible, perDrawUBOHandle, cubeVertexBuffer, cubeIndexBuffer,
+					cameraPosition, perFrameUBO.nearPlane, static_cast<uint32_t>(totalFrames));
+				renderingSystem.SetWriteMask(previousColorMask, previousDepthMask);
+			}
 		}
 
 		// Do lighting to temporary rendertarget (all lights in one pass -- extremly wasteful; 
@@ -270,13 +477,43 @@ int main(int argc, char* argv[])
 			renderingSystem.Draw(quadVertexBuffer, Graphics::BufferHandle::Invalid(), 6);
 		}
 #endif
+		// Read back the final image; written once the data arrives a few frames later
+		if (screenshotRequested)
+		{
+			const std::string filename = "screenshot" + std::to_string(screenshots++) + ".tga";
+			const uint16_t width = wc.width, height = wc.height;
+
+			renderingSystem.ReadRenderTarget(Graphics::DefaultRenderTarget(), Graphics::RenderTargetTexture::Color, 0, 0, width, height, 
+				[filename, width, height](const void* data, uint32_t size)
+			{
+				if (data && WriteTGA(filename, data, width, height))
+					printf("Saved %s\n", filename.c_str());
+				else
+					fprintf(stderr, "Failed to save %s\n", filename.c_str());
+			});
+
+			screenshotRequested = false;
+		}
+
 		renderingSystem.SubmitFrame();
 		++frames;
+		++totalFrames;
 
 		// Print FPS
 		if (timeAccum > 1.0)
 		{
 			printf("FPS: %f\n", frames / timeAccum);
+
+			uint64_t gBufferNanoseconds;
+			if (renderingSystem.GetQueryResult(gBufferTimer, gBufferNanoseconds))
+				printf("G-buffer pass: %.3f ms (GPU)\n", gBufferNanoseconds / 1e6);
+
+			const FrustumCuller::Stats& cullStats = frustumCuller.GetStats();
+			printf("Frustum-culling: %u plane-tests of %u (%u meshes and %u subtrees reused)\n", cullStats.planeTests,
+				static_cast<unsigned>(6 * frustumCuller.GetNumSpheres()), cullStats.reusedSpheres, cullStats.reusedNodes);
+
+			if (softwareOcclusionEnabled)
+				printf("Software occlusion-culled: %u of %u\n", softwareOccluded, softwareOccluded + visible.count);
 			frames = 0;
 			timeAccum = 0.0;
 		}
@@ -305,12 +542,43 @@ int main(int argc, char* argv[])
 			printf("Parallax-mapping: %s\n", parallaxMappingEnabled ? "ON" : "OFF");
 		}
 
-		// Hot reload of shaders
-		if (renderingSystem.IsKeyDown(Graphics::RenderingSystem::Key::SPACE))
+		if (renderingSystem.WasPressed(Graphics::RenderingSystem::Key::F4))
+		{
+			bool enabled = !renderingSystem.IsGLCallStatisticsEnabled();
+			renderingSystem.SetGLCallStatisticsEnabled(enabled);
+			printf("GL-call statistics: %s\n", enabled ? "ON" : "OFF");
+		}
+
+		if (renderingSystem.WasPressed(Graphics::RenderingSystem::Key::F5))
+			screenshotRequested = true;
+
+		if (renderingSystem.WasPressed(Graphics::RenderingSystem::Key::F6))
+		{
+			occlusionQueriesEnabled = !occlusionQueriesEnabled;
+			printf("Occlusion queries: %s\n", occlusionQueriesEnabled ? "ON" : "OFF");
+		}
+
+		if (renderingSystem.WasPressed(Graphics::RenderingSystem::Key::F7))
+		{
+			softwareOcclusionEnabled = !softwareOcclusionEnabled;
+			printf("Software occlusion-culling: %s\n", softwareOcclusionEnabled ? "ON" : "OFF");
+		}
+
+		// Shaders are reloaded automatically when their files change; this forces all of them
+		if (renderingSystem.WasPressed(Graphics::RenderingSystem::Key::SPACE))
 			renderingSystem.ReloadShaders();
 
 		if (renderingSystem.IsKeyDown(Graphics::RenderingSystem::Key::ESCAPE))
 			break;
+
+		if (headlessFrames > 0 && totalFrames >= headlessFrames)
+			break;
+	}
+
+	if (headlessFrames > 0)
+	{
+		const double elapsed = renderingSystem.GetTime() - startTime;
+		printf("Rendered %d frames in %.2f s (%.3f ms/frame)\n", totalFrames, elapsed, elapsed * 1000.0 / totalFrames);
 	}
 
 	renderingSystem.Shutdown();
@@ -0,0 +1,188 @@
+// Compares FrustumCuller, with and without its hierarchy and on one thread and on a thread-pool,
+// against testing one object at a time (how it used to work), reporting objects per second. The
+// camera turns once around over the iterations, and also 20 times slower to show results reused:
+//   CullingBenchmark [objects] [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "../src/FrustumCuller.h"
+#include "../src/ThreadPool.h"
+
+namespace
+{
+	struct Sphere
+	{
+		glm::vec3 position;
+		float radius;
+		char payload[96]; // Stand-in for the rest of a Renderable
+
+		glm::vec3 GetPosition() const { return position; }
+		float GetRadius() const { return radius; }
+	};
+
+	// FrustumCuller::InFrustum, but adding up the distance in the same order as the SIMD culler, so
+	// rounding can't make the results differ for spheres touching a plane
+	bool InFrustum(const glm::vec4 frustumPlanes[], const glm::vec3 point, float radius)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			const glm::vec4 plane = frustumPlanes[i];
+			const float d = (plane.x * point.x + plane.y * point.y) + plane.z * point.z + (plane.w + radius);
+			if (d < 0)
+				return false;
+		}
+
+		return true;
+	}
+
+	// The previous per-object culler
+	void CullPerObject(const std::vector<Sphere>& cullables, std::vector<bool>& isCulledVector, const glm::mat4& viewProj)
+	{
+		isCulledVector.clear();
+		isCulledVector.resize(cullables.size());
+
+		glm::vec4 frustumPlanes[6];
+		ExtractFrustumPlanes(viewProj, frustumPlanes);
+
+		for (size_t i = 0; i < cullables.size(); ++i)
+			isCulledVector[i] = !InFrustum(frustumPlanes, cullables[i].GetPosition(), cullables[i].GetRadius());
+	}
+
+	bool Matches(const std::vector<bool>& isCulledVector, const FrustumCuller::VisibleList& visible)
+	{
+		std::vector<bool> isCulled(isCulledVector.size(), true);
+		for (uint32_t index : visible)
+			isCulled[index] = false;
+
+		return isCulled == isCulledVector && std::count(isCulled.begin(), isCulled.end(), false) == visible.count;
+	}
+
+	double Seconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const size_t numObjects = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+	const int iterations = argc > 2 ? atoi(argv[2]) : 200;
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> radius(0.1f, 5.0f);
+
+	std::vector<Sphere> spheres(numObjects);
+	for (auto& sphere : spheres)
+	{
+		sphere.position = glm::vec3(position(rng), position(rng), position(rng));
+		sphere.radius = radius(rng);
+	}
+
+	// Without and with a hierarchy
+	FrustumCuller flatCuller;
+	flatCuller.Resize(spheres.size());
+	for (size_t i = 0; i < spheres.size(); ++i)
+		flatCuller.SetSphere(i, spheres[i].GetPosition(), spheres[i].GetRadius());
+
+	FrustumCuller culler;
+	culler.SetSpheres(spheres);
+
+	const glm::mat4 proj = glm::perspective(60.0f, 16.0f / 9.0f, 0.1f, 150.0f);
+	std::vector<glm::mat4> viewProjs, slowViewProjs;
+	for (int i = 0; i < iterations; ++i)
+	{
+		const float angle = 6.2831853f * i / iterations;
+		viewProjs.push_back(proj * glm::lookAt(glm::vec3(0.0f), glm::vec3(cos(angle), 0.1f, sin(angle)), glm::vec3(0, 1, 0)));
+
+		const float slowAngle = angle / 20.0f;
+		slowViewProjs.push_back(proj * glm::lookAt(glm::vec3(0.0f), glm::vec3(cos(slowAngle), 0.1f, sin(slowAngle)), glm::vec3(0, 1, 0)));
+	}
+
+	ThreadPool threadPool;
+
+	std::vector<bool> reference;
+	FrustumCuller::VisibleList visible;
+	size_t mismatches = 0;
+	for (const auto& viewProj : viewProjs)
+	{
+		CullPerObject(spheres, reference, viewProj);
+
+		flatCuller.Cull(visible, viewProj);
+		bool matches = Matches(reference, visible);
+		flatCuller.Cull(visible, viewProj, &threadPool);
+		matches &= Matches(reference, visible);
+		culler.Cull(visible, viewProj);
+		matches &= Matches(reference, visible);
+		culler.Cull(visible, viewProj, &threadPool);
+		matches &= Matches(reference, visible);
+
+		mismatches += !matches;
+	}
+
+	for (const auto& viewProj : slowViewProjs)
+	{
+		CullPerObject(spheres, reference, viewProj);
+
+		flatCuller.Cull(visible, viewProj);
+		bool matches = Matches(reference, visible);
+		culler.Cull(visible, viewProj, &threadPool);
+		matches &= Matches(reference, visible);
+
+		mismatches += !matches;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (const auto& viewProj : viewProjs)
+		CullPerObject(spheres, reference, viewProj);
+	const double perObjectTime = Seconds(start);
+
+	// Also counts the plane-tests done, compared to testing every object against every plane
+	double planeTests = 0.0;
+	auto time = [&](FrustumCuller& frustumCuller, ThreadPool* pool, bool computeDepths, const std::vector<glm::mat4>& cameras)
+	{
+		planeTests = 0.0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (const auto& viewProj : cameras)
+		{
+			frustumCuller.Cull(visible, viewProj, pool, computeDepths);
+			planeTests += frustumCuller.GetStats().planeTests;
+		}
+		return Seconds(start);
+	};
+
+	const double tested = double(numObjects) * iterations;
+	auto report = [&](const char* name, double seconds)
+	{
+		printf("%-28s %8.1f M objects/s (%.2fx), %5.1f%% of plane-tests\n", name, tested / seconds / 1e6, perObjectTime / seconds,
+			100.0 * planeTests / (6.0 * tested));
+	};
+
+	printf("%u objects, %d iterations, %u-wide SIMD, %u threads\n", static_cast<unsigned>(numObjects), iterations,
+		static_cast<unsigned>(FrustumCuller::SIMD_WIDTH), threadPool.GetNumThreads());
+	planeTests = 6.0 * tested;
+	report("Per-object:", perObjectTime);
+	report("Batch:", time(flatCuller, nullptr, false, viewProjs));
+	report("Batch, threaded:", time(flatCuller, &threadPool, false, viewProjs));
+	report("Hierarchy:", time(culler, nullptr, false, viewProjs));
+	report("Hierarchy, threaded:", time(culler, &threadPool, false, viewProjs));
+	report("Hierarchy, with depths:", time(culler, &threadPool, true, viewProjs));
+	report("Batch, slow camera:", time(flatCuller, nullptr, false, slowViewProjs));
+	report("Hierarchy, slow camera:", time(culler, &threadPool, false, slowViewProjs));
+
+	if (mismatches)
+	{
+		fprintf(stderr, "Results differ in %u of %d iterations\n", static_cast<unsigned>(mismatches), iterations);
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
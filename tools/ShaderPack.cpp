@@ -0,0 +1,52 @@
+// Packs shaders into an archive loaded by Graphics::ShaderArchive. Run from the directory the 
+// application runs from, so file-names match what it asks for:
+//   ShaderPack <archive> <shader-file>...
+// Each shader's includes are resolved against its own directory.
+
+#include <cstdio>
+#include <string>
+
+#include "../src/graphics/ShaderArchive.h"
+#include "../src/graphics/ShaderPreprocessor.h"
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "Usage: %s <archive> <shader-file>...\n", argv[0]);
+		return 1;
+	}
+
+	Graphics::ShaderArchive::Entries entries;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		const std::string file = argv[i];
+		const size_t slash = file.find_last_of("/\\");
+		const std::string includeDir = slash == std::string::npos ? "" : file.substr(0, slash + 1);
+
+		Graphics::ShaderPreprocessor::Result result = Graphics::ShaderPreprocessor::Process(file, includeDir);
+		if (!result.success)
+			return 1; // Reported by Process
+
+		Graphics::ShaderArchive::Entry& entry = entries[file];
+		entry.source = std::move(result.source);
+		entry.files = std::move(result.files);
+
+		for (const std::string& dependency : entry.files)
+		{
+			uint64_t hash = 0;
+			Graphics::ShaderArchive::HashFile(dependency, hash);
+			entry.hashes.push_back(hash);
+		}
+	}
+
+	if (!Graphics::ShaderArchive::Write(argv[1], entries))
+	{
+		fprintf(stderr, "Couldn't write %s\n", argv[1]);
+		return 1;
+	}
+
+	printf("Packed %d shaders into %s\n", argc - 2, argv[1]);
+	return 0;
+}
\ No newline at end of file